@@ -100,6 +100,7 @@ void loop() {
 
   if (client) {                             // if you get a client,
     Serial.println("new client");           // print a message out the serial port
+    client.setNoDelay(false);               // combine the small prints of the response
     String currentLine = "";                // make a String to hold incoming data from the client
     while (client.connected()) {            // loop while the client's connected
       delayMicroseconds(10);                // This is required for the Arduino Nano RP2040 Connect - otherwise it will loop so fast that SPI will never be served.
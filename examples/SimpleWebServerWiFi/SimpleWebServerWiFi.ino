@@ -68,6 +68,7 @@ void loop() {
 
   if (client) {                             // if you get a client,
     Serial.println("new client");           // print a message out the serial port
+    client.setNoDelay(false);               // combine the small prints of the response
     String currentLine = "";                // make a String to hold incoming data from the client
     while (client.connected()) {            // loop while the client's connected
       if (client.available()) {             // if there's bytes to read from the client,
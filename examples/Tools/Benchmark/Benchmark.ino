@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ *
+ * This example measures the throughput and per call latency of the
+ * library, so that changes can be compared on real hardware, or without
+ * hardware against the simulated module of the host build in extras/host.
+ *
+ * It reports:
+ *  - AT command round trip time (a plain "AT" with WiFi.AT())
+ *  - WiFiClient write and read against a TCP echo server
+ *  - WiFiUDP endPacket and parsePacket against a UDP echo server, each
+ *    packet is read back before the next one is sent
+ *  - WiFiServer available with no pending clients
+ *
+ * Throughput (bytes/s) is taken over the whole of each phase, including
+ * the time spent between calls waiting for data, the latencies are per call.
+ *
+ * A TCP and UDP echo server can be started on a host computer with:
+ *
+ *   ncat -l 7777 --keep-open --exec /bin/cat
+ *   ncat -u -l 7777 --keep-open --exec /bin/cat
+ *
+ * The simulated module echoes TCP and UDP data itself, run it with:
+ *
+ *   make -C extras/host run
+ *
+ *  Circuit:
+ *  - SparkFun Qwiic WiFi Shield - DA16200 attached
+ *
+ */
+
+#include <DA16200_WiFi.h>
+#include <WiFiUdp.h>
+
+///////please enter your sensitive data in the Secret tab/arduino_secrets.h
+#include "arduino_secrets.h"
+
+char ssid[] = SECRET_SSID;        // your network SSID (name)
+char pass[] = SECRET_PASS;        // your network password
+
+IPAddress echoServer(192, 168, 1, 100); // address of the host running the echo servers
+uint16_t echoPort = 7777;               // port of the TCP and UDP echo servers
+uint16_t serverPort = 8080;             // local port used for the WiFiServer benchmark
+
+#define ITERATIONS  32  // number of samples per benchmark
+#define BUFFER_SIZE 512 // size of each TCP write and UDP packet
+
+unsigned long samples[ITERATIONS];
+unsigned long replySamples[ITERATIONS];
+uint8_t buffer[BUFFER_SIZE];
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial); // wait for the serial monitor to be opened
+
+  // check for the WiFi module:
+  if (WiFi.status() == WL_NO_MODULE) {
+    Serial.println("Communication with WiFi module failed!");
+    // don't continue
+    while (true);
+  }
+
+  // attempt to connect to WiFi network:
+  while (WiFi.begin(ssid, pass) != WL_CONNECTED) {
+    Serial.print("Attempting to connect to SSID: ");
+    Serial.println(ssid);
+
+    // wait 10 seconds before retrying
+    delay(10000);
+  }
+
+  for (int i = 0; i < BUFFER_SIZE; i++) {
+    buffer[i] = 'A' + (i % 26);
+  }
+
+  Serial.println("benchmark                 count     bytes/s      min      p50      p90      p99      max (us)");
+
+  benchmarkAT();
+  benchmarkClient();
+  benchmarkUDP();
+  benchmarkServer();
+
+  Serial.println("done");
+}
+
+void loop() {
+  // do nothing
+}
+
+void benchmarkAT() {
+  for (int i = 0; i < ITERATIONS; i++) {
+    unsigned long start = micros();
+
+    WiFi.AT();
+
+    samples[i] = micros() - start;
+  }
+
+  report("WiFiClass::AT", samples, ITERATIONS, 0, 0);
+}
+
+void benchmarkClient() {
+  WiFiClient client;
+
+  if (!client.connect(echoServer, echoPort)) {
+    Serial.println("WiFiClient: connection to echo server failed");
+    return;
+  }
+
+  unsigned long bytes = 0;
+  unsigned long phase = micros();
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    unsigned long start = micros();
+
+    bytes += client.write(buffer, BUFFER_SIZE);
+
+    samples[i] = micros() - start;
+  }
+
+  report("WiFiClient::write", samples, ITERATIONS, bytes, micros() - phase);
+
+  int count = 0;
+  unsigned long elapsed = 0;
+
+  bytes = 0;
+  phase = micros();
+
+  for (unsigned long timeout = millis(); count < ITERATIONS && (millis() - timeout) < 10000;) {
+    unsigned long start = micros();
+
+    int result = client.read(buffer, BUFFER_SIZE);
+
+    if (result > 0) {
+      samples[count++] = micros() - start;
+      bytes += result;
+      elapsed = micros() - phase;
+      timeout = millis();
+    }
+  }
+
+  report("WiFiClient::read", samples, count, bytes, elapsed);
+
+  client.stop();
+}
+
+void benchmarkUDP() {
+  WiFiUDP udp;
+
+  if (!udp.begin(echoPort)) {
+    Serial.println("WiFiUDP: begin failed");
+    return;
+  }
+
+  unsigned long bytes = 0;
+  unsigned long replyBytes = 0;
+  int replies = 0;
+  unsigned long phase = micros();
+
+  // one packet in flight at a time, so that the echoes do not overrun the receive buffer
+  for (int i = 0; i < ITERATIONS; i++) {
+    udp.beginPacket(echoServer, echoPort);
+    udp.write(buffer, BUFFER_SIZE);
+
+    unsigned long start = micros();
+
+    if (udp.endPacket() == 0) {
+      bytes += BUFFER_SIZE;
+    }
+
+    samples[i] = micros() - start;
+
+    for (unsigned long timeout = millis(); (millis() - timeout) < 1000;) {
+      start = micros();
+
+      int result = udp.parsePacket();
+
+      if (result > 0) {
+        replySamples[replies++] = micros() - start;
+        replyBytes += result;
+        break;
+      }
+    }
+  }
+
+  unsigned long elapsed = micros() - phase;
+
+  report("WiFiUDP::endPacket", samples, ITERATIONS, bytes, elapsed);
+  report("WiFiUDP::parsePacket", replySamples, replies, replyBytes, elapsed);
+
+  udp.stop();
+}
+
+void benchmarkServer() {
+  WiFiServer server(serverPort);
+
+  server.begin();
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    unsigned long start = micros();
+
+    server.available();
+
+    samples[i] = micros() - start;
+  }
+
+  report("WiFiServer::available", samples, ITERATIONS, 0, 0);
+
+  server.stop();
+}
+
+void report(const char* name, unsigned long* samples, int count, unsigned long bytes, unsigned long elapsed) {
+  Serial.print(name);
+  for (int i = strlen(name); i < 24; i++) {
+    Serial.print(' ');
+  }
+
+  if (count == 0) {
+    Serial.println("no samples");
+    return;
+  }
+
+  // insertion sort, the sample count is small
+  for (int i = 0; i < count; i++) {
+    unsigned long sample = samples[i];
+    int j = i;
+
+    for (; j > 0 && samples[j - 1] > sample; j--) {
+      samples[j] = samples[j - 1];
+    }
+    samples[j] = sample;
+  }
+
+  printColumn(count, 7);
+  printColumn(elapsed ? (unsigned long)((bytes * 1000000.0) / elapsed) : 0, 12);
+  printColumn(samples[0], 9);
+  printColumn(samples[(count * 50) / 100], 9);
+  printColumn(samples[(count * 90) / 100], 9);
+  printColumn(samples[(count * 99) / 100], 9);
+  printColumn(samples[count - 1], 9);
+  Serial.println();
+}
+
+void printColumn(unsigned long value, int width) {
+  char column[24];
+
+  sprintf(column, "%*lu", width, value);
+
+  Serial.print(column);
+}
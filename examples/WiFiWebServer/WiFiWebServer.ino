@@ -68,6 +68,8 @@ void loop() {
   WiFiClient client = server.available();
   if (client) {
     Serial.println("new client");
+    // combine the many small prints of the response into fewer sends
+    client.setNoDelay(false);
     // an HTTP request ends with a blank line
     boolean currentLineIsBlank = true;
     while (client.connected()) {
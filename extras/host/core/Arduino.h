@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+// Minimal Arduino core for building the library and sketches on a Linux host
+
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define LED_BUILTIN 13
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+int analogRead(int pin);
+
+#define word(high, low) ((uint16_t)(((high) << 8) | (low)))
+
+void attachInterrupt(int pin, void (*handler)(void), int mode);
+void detachInterrupt(int pin);
+void noInterrupts();
+void interrupts();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#ifdef __cplusplus
+#include "WString.h"
+#include "Print.h"
+#include "Printable.h"
+#include "Stream.h"
+#include "IPAddress.h"
+#include "RingBuffer.h"
+#include "HardwareSerial.h"
+
+// the console, written to stdout
+extern HardwareSerial& Serial;
+
+// the serial port the shield is attached to, see DA16200Simulator
+extern HardwareSerial& Serial1;
+#define SERIAL_PORT_HARDWARE Serial1
+#define SERIAL_PORT_HARDWARE_OPEN Serial1
+
+void setup();
+void loop();
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _HOST_HARDWARE_SERIAL_H_
+#define _HOST_HARDWARE_SERIAL_H_
+
+#include "Stream.h"
+
+#define SERIAL_8N1 0x06
+
+class HardwareSerial : public Stream {
+  public:
+    virtual void begin(unsigned long baudrate) = 0;
+    virtual void begin(unsigned long baudrate, uint16_t config) { (void)config; begin(baudrate); }
+    virtual void end() = 0;
+    virtual operator bool() { return true; }
+};
+
+#endif
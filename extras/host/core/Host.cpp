@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#include <chrono>
+#include <thread>
+
+#include "Arduino.h"
+#include "Host.h"
+
+#define HOST_MAX_HOOKS 4
+
+struct HostHook {
+  void (*tick)(void*);
+  void (*pinWrite)(void*, int, int);
+  void* context;
+};
+
+static HostHook tickHooks[HOST_MAX_HOOKS];
+static int tickHookCount = 0;
+static HostHook pinWriteHooks[HOST_MAX_HOOKS];
+static int pinWriteHookCount = 0;
+
+static struct {
+  int mode;
+  int value;
+  void (*handler)(void);
+  int edge;
+  bool pending;
+} pins[HOST_NUM_PINS];
+
+static bool interruptsEnabled = true;
+static bool inInterrupt = false;
+static bool inTick = false;
+
+static void runPendingInterrupts()
+{
+  if (!interruptsEnabled || inInterrupt) {
+    return;
+  }
+
+  for (int pin = 0; pin < HOST_NUM_PINS; pin++) {
+    if (pins[pin].pending && pins[pin].handler != NULL) {
+      pins[pin].pending = false;
+
+      inInterrupt = true;
+      interruptsEnabled = false;
+      pins[pin].handler();
+      interruptsEnabled = true;
+      inInterrupt = false;
+    }
+  }
+}
+
+static void tick()
+{
+  if (!interruptsEnabled || inInterrupt || inTick) {
+    return;
+  }
+
+  inTick = true;
+  for (int i = 0; i < tickHookCount; i++) {
+    tickHooks[i].tick(tickHooks[i].context);
+  }
+  inTick = false;
+
+  runPendingInterrupts();
+}
+
+uint64_t hostMicros()
+{
+  static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void hostOnTick(void (*hook)(void*), void* context)
+{
+  if (tickHookCount < HOST_MAX_HOOKS) {
+    tickHooks[tickHookCount].tick = hook;
+    tickHooks[tickHookCount].context = context;
+    tickHookCount++;
+  }
+}
+
+void hostOnPinWrite(void (*hook)(void*, int, int), void* context)
+{
+  if (pinWriteHookCount < HOST_MAX_HOOKS) {
+    pinWriteHooks[pinWriteHookCount].pinWrite = hook;
+    pinWriteHooks[pinWriteHookCount].context = context;
+    pinWriteHookCount++;
+  }
+}
+
+void hostSetPin(int pin, int value)
+{
+  if (pin < 0 || pin >= HOST_NUM_PINS) {
+    return;
+  }
+
+  int previous = pins[pin].value;
+
+  pins[pin].value = value ? HIGH : LOW;
+
+  if (pins[pin].handler == NULL || previous == pins[pin].value) {
+    return;
+  }
+
+  if (pins[pin].edge == CHANGE ||
+      (pins[pin].edge == RISING && pins[pin].value == HIGH) ||
+      (pins[pin].edge == FALLING && pins[pin].value == LOW)) {
+    pins[pin].pending = true;
+  }
+}
+
+bool hostInInterrupt()
+{
+  return inInterrupt;
+}
+
+unsigned long millis()
+{
+  tick();
+
+  return (unsigned long)(hostMicros() / 1000);
+}
+
+unsigned long micros()
+{
+  tick();
+
+  return (unsigned long)hostMicros();
+}
+
+void delay(unsigned long ms)
+{
+  uint64_t end = hostMicros() + (uint64_t)ms * 1000;
+
+  do {
+    tick();
+
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  } while (hostMicros() < end);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  uint64_t end = hostMicros() + us;
+
+  while (hostMicros() < end) {
+  }
+}
+
+void yield()
+{
+  tick();
+}
+
+void pinMode(int pin, int mode)
+{
+  if (pin < 0 || pin >= HOST_NUM_PINS) {
+    return;
+  }
+
+  pins[pin].mode = mode;
+
+  if (mode == INPUT_PULLUP) {
+    hostSetPin(pin, HIGH);
+  }
+}
+
+void digitalWrite(int pin, int value)
+{
+  if (pin < 0 || pin >= HOST_NUM_PINS) {
+    return;
+  }
+
+  pins[pin].value = value ? HIGH : LOW;
+
+  for (int i = 0; i < pinWriteHookCount; i++) {
+    pinWriteHooks[i].pinWrite(pinWriteHooks[i].context, pin, pins[pin].value);
+  }
+}
+
+int digitalRead(int pin)
+{
+  if (pin < 0 || pin >= HOST_NUM_PINS) {
+    return LOW;
+  }
+
+  return pins[pin].value;
+}
+
+int analogRead(int pin)
+{
+  return random(1024);
+}
+
+void attachInterrupt(int pin, void (*handler)(void), int mode)
+{
+  if (pin < 0 || pin >= HOST_NUM_PINS) {
+    return;
+  }
+
+  pins[pin].handler = handler;
+  pins[pin].edge = mode;
+  pins[pin].pending = false;
+}
+
+void detachInterrupt(int pin)
+{
+  if (pin < 0 || pin >= HOST_NUM_PINS) {
+    return;
+  }
+
+  pins[pin].handler = NULL;
+  pins[pin].pending = false;
+}
+
+void noInterrupts()
+{
+  interruptsEnabled = false;
+}
+
+void interrupts()
+{
+  interruptsEnabled = true;
+
+  runPendingInterrupts();
+}
+
+long random(long max)
+{
+  return (max > 0) ? (rand() % max) : 0;
+}
+
+long random(long min, long max)
+{
+  return (max > min) ? (min + random(max - min)) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+  srand(seed);
+}
+
+// the console, Serial.print() goes to stdout
+class ConsoleSerial : public HardwareSerial {
+  public:
+    virtual void begin(unsigned long) {}
+    virtual void end() {}
+
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int peek() { return -1; }
+
+    virtual size_t write(uint8_t b) { return fwrite(&b, 1, 1, stdout); }
+    virtual size_t write(const uint8_t* buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+    virtual int availableForWrite() { return 4096; }
+    virtual void flush() { fflush(stdout); }
+
+    using Print::write;
+};
+
+static ConsoleSerial console;
+HardwareSerial& Serial = console;
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _HOST_HOST_H_
+#define _HOST_HOST_H_
+
+// hooks for simulated peripherals, not part of the Arduino API
+
+#include <stdint.h>
+
+#define HOST_NUM_PINS 64
+
+// monotonic time that does not run the tick hooks, for use by the hooks themselves
+uint64_t hostMicros();
+
+// called from millis(), micros(), delay() and yield() while interrupts are enabled, this
+// is how simulated peripherals advance while the sketch busy waits
+void hostOnTick(void (*hook)(void*), void* context);
+
+// called whenever the sketch drives a pin with digitalWrite()
+void hostOnPinWrite(void (*hook)(void*, int, int), void* context);
+
+// drives an input pin from a simulated peripheral, runs the attached interrupt handler
+// (now or once interrupts are enabled again) on a matching edge
+void hostSetPin(int pin, int value);
+
+// true while an interrupt handler runs
+bool hostInInterrupt();
+
+#endif
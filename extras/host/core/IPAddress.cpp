@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Print.h"
+#include "IPAddress.h"
+
+const IPAddress INADDR_NONE(0, 0, 0, 0);
+
+IPAddress::IPAddress()
+{
+  _address.dword = 0;
+}
+
+IPAddress::IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth)
+{
+  _address.bytes[0] = first;
+  _address.bytes[1] = second;
+  _address.bytes[2] = third;
+  _address.bytes[3] = fourth;
+}
+
+IPAddress::IPAddress(uint32_t address)
+{
+  _address.dword = address;
+}
+
+IPAddress::IPAddress(const uint8_t* address)
+{
+  memcpy(_address.bytes, address, sizeof(_address.bytes));
+}
+
+bool IPAddress::fromString(const char* address)
+{
+  unsigned int octets[4];
+  char extra;
+
+  if (sscanf(address, "%u.%u.%u.%u%c", &octets[0], &octets[1], &octets[2], &octets[3], &extra) != 4) {
+    return false;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    if (octets[i] > 255) {
+      return false;
+    }
+
+    _address.bytes[i] = octets[i];
+  }
+
+  return true;
+}
+
+bool IPAddress::fromString(const String& address)
+{
+  return fromString(address.c_str());
+}
+
+IPAddress::operator uint32_t() const
+{
+  return _address.dword;
+}
+
+bool IPAddress::operator==(const IPAddress& addr) const
+{
+  return _address.dword == addr._address.dword;
+}
+
+bool IPAddress::operator!=(const IPAddress& addr) const
+{
+  return _address.dword != addr._address.dword;
+}
+
+bool IPAddress::operator==(const uint8_t* addr) const
+{
+  return memcmp(addr, _address.bytes, sizeof(_address.bytes)) == 0;
+}
+
+uint8_t IPAddress::operator[](int index) const
+{
+  return _address.bytes[index];
+}
+
+uint8_t& IPAddress::operator[](int index)
+{
+  return _address.bytes[index];
+}
+
+IPAddress& IPAddress::operator=(const uint8_t* address)
+{
+  memcpy(_address.bytes, address, sizeof(_address.bytes));
+
+  return *this;
+}
+
+IPAddress& IPAddress::operator=(uint32_t address)
+{
+  _address.dword = address;
+
+  return *this;
+}
+
+String IPAddress::toString() const
+{
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "%d.%d.%d.%d", _address.bytes[0], _address.bytes[1], _address.bytes[2], _address.bytes[3]);
+
+  return String(buf);
+}
+
+size_t IPAddress::printTo(Print& p) const
+{
+  return p.print(toString());
+}
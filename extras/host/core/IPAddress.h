@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _HOST_IPADDRESS_H_
+#define _HOST_IPADDRESS_H_
+
+#include <stdint.h>
+
+#include "Printable.h"
+#include "WString.h"
+
+class IPAddress : public Printable {
+  public:
+    IPAddress();
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth);
+    IPAddress(uint32_t address);
+    IPAddress(const uint8_t* address);
+
+    bool fromString(const char* address);
+    bool fromString(const String& address);
+
+    operator uint32_t() const;
+    bool operator==(const IPAddress& addr) const;
+    bool operator!=(const IPAddress& addr) const;
+    bool operator==(const uint8_t* addr) const;
+
+    uint8_t operator[](int index) const;
+    uint8_t& operator[](int index);
+
+    IPAddress& operator=(const uint8_t* address);
+    IPAddress& operator=(uint32_t address);
+
+    String toString() const;
+
+    virtual size_t printTo(Print& p) const;
+
+  private:
+    union {
+      uint8_t bytes[4];
+      uint32_t dword;
+    } _address;
+};
+
+extern const IPAddress INADDR_NONE;
+
+#endif
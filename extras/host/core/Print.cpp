@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#include <stdio.h>
+
+#include "Print.h"
+
+Print::Print() :
+  _writeError(0)
+{
+}
+
+int Print::getWriteError()
+{
+  return _writeError;
+}
+
+void Print::clearWriteError()
+{
+  setWriteError(0);
+}
+
+void Print::setWriteError(int error)
+{
+  _writeError = error;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+
+  while (size--) {
+    if (write(*buffer++) == 0) {
+      break;
+    }
+
+    n++;
+  }
+
+  return n;
+}
+
+size_t Print::write(const char* str)
+{
+  if (str == NULL) {
+    return 0;
+  }
+
+  return write((const uint8_t*)str, strlen(str));
+}
+
+size_t Print::write(const char* buffer, size_t size)
+{
+  return write((const uint8_t*)buffer, size);
+}
+
+int Print::availableForWrite()
+{
+  return 0;
+}
+
+void Print::flush()
+{
+}
+
+size_t Print::print(const String& s)
+{
+  return write((const uint8_t*)s.c_str(), s.length());
+}
+
+size_t Print::print(const char* s)
+{
+  return write(s);
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base)
+{
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base)
+{
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base)
+{
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(long value, int base)
+{
+  if (base == 10 && value < 0) {
+    return printNumber(-(unsigned long)value, base, true);
+  }
+
+  return printNumber((unsigned long)value, base, false);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  return printNumber(value, base, false);
+}
+
+size_t Print::print(double value, int digits)
+{
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "%.*f", digits, value);
+
+  return write(buf);
+}
+
+size_t Print::print(const Printable& p)
+{
+  return p.printTo(*this);
+}
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+size_t Print::println(const String& s)
+{
+  size_t n = print(s);
+
+  return n + println();
+}
+
+size_t Print::println(const char* s)
+{
+  size_t n = print(s);
+
+  return n + println();
+}
+
+size_t Print::println(char c)
+{
+  size_t n = print(c);
+
+  return n + println();
+}
+
+size_t Print::println(unsigned char value, int base)
+{
+  size_t n = print(value, base);
+
+  return n + println();
+}
+
+size_t Print::println(int value, int base)
+{
+  size_t n = print(value, base);
+
+  return n + println();
+}
+
+size_t Print::println(unsigned int value, int base)
+{
+  size_t n = print(value, base);
+
+  return n + println();
+}
+
+size_t Print::println(long value, int base)
+{
+  size_t n = print(value, base);
+
+  return n + println();
+}
+
+size_t Print::println(unsigned long value, int base)
+{
+  size_t n = print(value, base);
+
+  return n + println();
+}
+
+size_t Print::println(double value, int digits)
+{
+  size_t n = print(value, digits);
+
+  return n + println();
+}
+
+size_t Print::println(const Printable& p)
+{
+  size_t n = print(p);
+
+  return n + println();
+}
+
+size_t Print::printNumber(unsigned long value, int base, bool negative)
+{
+  char buf[8 * sizeof(long) + 2];
+  char* str = &buf[sizeof(buf) - 1];
+
+  if (base < 2) {
+    base = 10;
+  }
+
+  *str = '\0';
+
+  do {
+    int digit = value % base;
+
+    *--str = (digit < 10) ? ('0' + digit) : ('A' + digit - 10);
+    value /= base;
+  } while (value);
+
+  if (negative) {
+    *--str = '-';
+  }
+
+  return write(str);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _HOST_PRINT_H_
+#define _HOST_PRINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "WString.h"
+#include "Printable.h"
+
+class Print {
+  public:
+    Print();
+    virtual ~Print() {}
+
+    int getWriteError();
+    void clearWriteError();
+
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str);
+    size_t write(const char* buffer, size_t size);
+
+    virtual int availableForWrite();
+    virtual void flush();
+
+    size_t print(const String& s);
+    size_t print(const char* s);
+    size_t print(char c);
+    size_t print(unsigned char value, int base = 10);
+    size_t print(int value, int base = 10);
+    size_t print(unsigned int value, int base = 10);
+    size_t print(long value, int base = 10);
+    size_t print(unsigned long value, int base = 10);
+    size_t print(double value, int digits = 2);
+    size_t print(const Printable& p);
+
+    size_t println();
+    size_t println(const String& s);
+    size_t println(const char* s);
+    size_t println(char c);
+    size_t println(unsigned char value, int base = 10);
+    size_t println(int value, int base = 10);
+    size_t println(unsigned int value, int base = 10);
+    size_t println(long value, int base = 10);
+    size_t println(unsigned long value, int base = 10);
+    size_t println(double value, int digits = 2);
+    size_t println(const Printable& p);
+
+  protected:
+    void setWriteError(int error = 1);
+
+  private:
+    size_t printNumber(unsigned long value, int base, bool negative);
+
+  private:
+    int _writeError;
+};
+
+#endif
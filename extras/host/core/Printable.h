@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _HOST_PRINTABLE_H_
+#define _HOST_PRINTABLE_H_
+
+class Print;
+
+class Printable {
+  public:
+    virtual ~Printable() {}
+
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _HOST_RING_BUFFER_H_
+#define _HOST_RING_BUFFER_H_
+
+#include <stdint.h>
+
+template <int N>
+class RingBufferN {
+  public:
+    RingBufferN() { clear(); }
+
+    void store_char(uint8_t c)
+    {
+      if (!isFull()) {
+        _aucBuffer[_iHead] = c;
+        _iHead = nextIndex(_iHead);
+        _numElems++;
+      }
+    }
+
+    void clear()
+    {
+      _iHead = 0;
+      _iTail = 0;
+      _numElems = 0;
+    }
+
+    int read_char()
+    {
+      if (_numElems == 0) {
+        return -1;
+      }
+
+      uint8_t value = _aucBuffer[_iTail];
+
+      _iTail = nextIndex(_iTail);
+      _numElems--;
+
+      return value;
+    }
+
+    int available() { return _numElems; }
+    int availableForStore() { return N - _numElems; }
+    int peek() { return (_numElems > 0) ? _aucBuffer[_iTail] : -1; }
+    bool isFull() { return _numElems == N; }
+
+  public:
+    uint8_t _aucBuffer[N];
+    volatile int _iHead;
+    volatile int _iTail;
+    volatile int _numElems;
+
+  private:
+    int nextIndex(int index) { return (index + 1) % N; }
+};
+
+typedef RingBufferN<64> RingBuffer;
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _HOST_SERVER_H_
+#define _HOST_SERVER_H_
+
+#include "Print.h"
+
+class Server : public Print {
+  public:
+    virtual void begin() = 0;
+};
+
+#endif
@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WString.h"
+
+String::String(const char* cstr) :
+  _buffer(NULL),
+  _capacity(0),
+  _length(0)
+{
+  *this = (cstr != NULL) ? cstr : "";
+}
+
+String::String(const String& str) :
+  _buffer(NULL),
+  _capacity(0),
+  _length(0)
+{
+  *this = str;
+}
+
+String::String(char c) :
+  _buffer(NULL),
+  _capacity(0),
+  _length(0)
+{
+  concat(&c, 1);
+}
+
+String::String(int value, unsigned char base) :
+  String((long)value, base)
+{
+}
+
+String::String(unsigned int value, unsigned char base) :
+  String((unsigned long)value, base)
+{
+}
+
+String::String(long value, unsigned char base) :
+  _buffer(NULL),
+  _capacity(0),
+  _length(0)
+{
+  char buf[2 + 8 * sizeof(long)];
+
+  if (base == 10 || value >= 0) {
+    snprintf(buf, sizeof(buf), (base == 16) ? "%lx" : "%ld", value);
+  } else {
+    snprintf(buf, sizeof(buf), "%lx", (unsigned long)value);
+  }
+
+  *this = buf;
+}
+
+String::String(unsigned long value, unsigned char base) :
+  _buffer(NULL),
+  _capacity(0),
+  _length(0)
+{
+  char buf[2 + 8 * sizeof(long)];
+
+  snprintf(buf, sizeof(buf), (base == 16) ? "%lx" : "%lu", value);
+
+  *this = buf;
+}
+
+String::~String()
+{
+  free(_buffer);
+}
+
+String& String::operator=(const String& rhs)
+{
+  if (this != &rhs) {
+    _length = 0;
+    concat(rhs.c_str(), rhs._length);
+  }
+
+  return *this;
+}
+
+String& String::operator=(const char* cstr)
+{
+  if (cstr == NULL) {
+    // as in the Arduino cores, assigning NULL gives back the buffer
+    free(_buffer);
+    _buffer = NULL;
+    _capacity = 0;
+    _length = 0;
+
+    return *this;
+  }
+
+  _length = 0;
+  concat(cstr, strlen(cstr));
+
+  return *this;
+}
+
+unsigned char String::reserve(unsigned int size)
+{
+  if (size < _capacity) {
+    return 1;
+  }
+
+  char* buffer = (char*)realloc(_buffer, size + 1);
+
+  if (buffer == NULL) {
+    return 0;
+  }
+
+  _buffer = buffer;
+  _capacity = size + 1;
+  _buffer[_length] = '\0';
+
+  return 1;
+}
+
+unsigned int String::length() const
+{
+  return _length;
+}
+
+const char* String::c_str() const
+{
+  return (_buffer != NULL) ? _buffer : "";
+}
+
+unsigned char String::concat(const char* cstr, unsigned int length)
+{
+  if (!reserve(_length + length)) {
+    return 0;
+  }
+
+  memmove(_buffer + _length, cstr, length);
+  _length += length;
+  _buffer[_length] = '\0';
+
+  return 1;
+}
+
+String& String::operator+=(const String& rhs)
+{
+  String copy(rhs);
+
+  concat(copy.c_str(), copy._length);
+
+  return *this;
+}
+
+String& String::operator+=(const char* cstr)
+{
+  concat(cstr, strlen(cstr));
+
+  return *this;
+}
+
+String& String::operator+=(char c)
+{
+  concat(&c, 1);
+
+  return *this;
+}
+
+String& String::operator+=(int value)
+{
+  return *this += String(value);
+}
+
+String& String::operator+=(unsigned long value)
+{
+  return *this += String(value);
+}
+
+String operator+(const String& lhs, const String& rhs)
+{
+  String result(lhs);
+
+  result += rhs;
+
+  return result;
+}
+
+String operator+(const String& lhs, const char* rhs)
+{
+  String result(lhs);
+
+  result += rhs;
+
+  return result;
+}
+
+bool String::equals(const String& str) const
+{
+  return _length == str._length && strcmp(c_str(), str.c_str()) == 0;
+}
+
+bool String::equals(const char* cstr) const
+{
+  return strcmp(c_str(), cstr) == 0;
+}
+
+bool String::operator==(const String& rhs) const
+{
+  return equals(rhs);
+}
+
+bool String::operator==(const char* cstr) const
+{
+  return equals(cstr);
+}
+
+bool String::operator!=(const String& rhs) const
+{
+  return !equals(rhs);
+}
+
+bool String::operator!=(const char* cstr) const
+{
+  return !equals(cstr);
+}
+
+int String::compareTo(const String& str) const
+{
+  return strcmp(c_str(), str.c_str());
+}
+
+bool String::operator<(const String& rhs) const
+{
+  return compareTo(rhs) < 0;
+}
+
+bool String::operator>(const String& rhs) const
+{
+  return compareTo(rhs) > 0;
+}
+
+bool String::operator<=(const String& rhs) const
+{
+  return compareTo(rhs) <= 0;
+}
+
+bool String::operator>=(const String& rhs) const
+{
+  return compareTo(rhs) >= 0;
+}
+
+bool String::startsWith(const String& prefix) const
+{
+  return startsWith(prefix.c_str());
+}
+
+bool String::startsWith(const char* prefix) const
+{
+  size_t length = strlen(prefix);
+
+  return length <= _length && strncmp(c_str(), prefix, length) == 0;
+}
+
+bool String::endsWith(const String& suffix) const
+{
+  return endsWith(suffix.c_str());
+}
+
+bool String::endsWith(const char* suffix) const
+{
+  size_t length = strlen(suffix);
+
+  return length <= _length && strcmp(c_str() + _length - length, suffix) == 0;
+}
+
+char String::charAt(unsigned int index) const
+{
+  return (index < _length) ? _buffer[index] : '\0';
+}
+
+void String::setCharAt(unsigned int index, char c)
+{
+  if (index < _length) {
+    _buffer[index] = c;
+  }
+}
+
+char String::operator[](unsigned int index) const
+{
+  return charAt(index);
+}
+
+char& String::operator[](unsigned int index)
+{
+  static char dummy;
+
+  if (index >= _length) {
+    dummy = '\0';
+    return dummy;
+  }
+
+  return _buffer[index];
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+  if (from >= _length) {
+    return -1;
+  }
+
+  const char* found = strchr(c_str() + from, c);
+
+  return (found != NULL) ? (int)(found - c_str()) : -1;
+}
+
+int String::indexOf(const String& str, unsigned int from) const
+{
+  return indexOf(str.c_str(), from);
+}
+
+int String::indexOf(const char* str, unsigned int from) const
+{
+  if (from > _length) {
+    return -1;
+  }
+
+  const char* found = strstr(c_str() + from, str);
+
+  return (found != NULL) ? (int)(found - c_str()) : -1;
+}
+
+int String::lastIndexOf(char c) const
+{
+  const char* found = strrchr(c_str(), c);
+
+  return (found != NULL) ? (int)(found - c_str()) : -1;
+}
+
+String String::substring(unsigned int from) const
+{
+  return substring(from, _length);
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  String result;
+
+  if (from > to) {
+    unsigned int tmp = from;
+
+    from = to;
+    to = tmp;
+  }
+
+  if (to > _length) {
+    to = _length;
+  }
+
+  if (from < to) {
+    result.concat(c_str() + from, to - from);
+  }
+
+  return result;
+}
+
+void String::trim()
+{
+  unsigned int start = 0;
+
+  while (start < _length && isspace((unsigned char)_buffer[start])) {
+    start++;
+  }
+
+  while (_length > start && isspace((unsigned char)_buffer[_length - 1])) {
+    _length--;
+  }
+
+  if (_buffer != NULL) {
+    memmove(_buffer, _buffer + start, _length - start);
+    _length -= start;
+    _buffer[_length] = '\0';
+  }
+}
+
+void String::toLowerCase()
+{
+  for (unsigned int i = 0; i < _length; i++) {
+    _buffer[i] = tolower((unsigned char)_buffer[i]);
+  }
+}
+
+void String::toUpperCase()
+{
+  for (unsigned int i = 0; i < _length; i++) {
+    _buffer[i] = toupper((unsigned char)_buffer[i]);
+  }
+}
+
+long String::toInt() const
+{
+  return atol(c_str());
+}
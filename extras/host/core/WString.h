@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _HOST_WSTRING_H_
+#define _HOST_WSTRING_H_
+
+#include <stddef.h>
+
+class String {
+  public:
+    String(const char* cstr = "");
+    String(const String& str);
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    ~String();
+
+    String& operator=(const String& rhs);
+    String& operator=(const char* cstr);
+
+    unsigned char reserve(unsigned int size);
+    unsigned int length() const;
+    const char* c_str() const;
+
+    String& operator+=(const String& rhs);
+    String& operator+=(const char* cstr);
+    String& operator+=(char c);
+    String& operator+=(int value);
+    String& operator+=(unsigned long value);
+    friend String operator+(const String& lhs, const String& rhs);
+    friend String operator+(const String& lhs, const char* rhs);
+
+    bool equals(const String& str) const;
+    bool equals(const char* cstr) const;
+    bool operator==(const String& rhs) const;
+    bool operator==(const char* cstr) const;
+    bool operator!=(const String& rhs) const;
+    bool operator!=(const char* cstr) const;
+    int compareTo(const String& str) const;
+    bool operator<(const String& rhs) const;
+    bool operator>(const String& rhs) const;
+    bool operator<=(const String& rhs) const;
+    bool operator>=(const String& rhs) const;
+
+    bool startsWith(const String& prefix) const;
+    bool startsWith(const char* prefix) const;
+    bool endsWith(const String& suffix) const;
+    bool endsWith(const char* suffix) const;
+
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char& operator[](unsigned int index);
+
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& str, unsigned int from = 0) const;
+    int indexOf(const char* str, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    long toInt() const;
+
+  private:
+    unsigned char concat(const char* cstr, unsigned int length);
+
+  private:
+    char* _buffer;
+    unsigned int _capacity;
+    unsigned int _length;
+};
+
+#endif
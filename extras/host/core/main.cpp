@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#include "Arduino.h"
+
+// runs setup() and then loop(), forever or the number of times given as the first argument
+int main(int argc, char* argv[])
+{
+  long count = (argc > 1) ? atol(argv[1]) : -1;
+
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  setup();
+
+  for (long i = 0; count < 0 || i < count; i++) {
+    loop();
+  }
+
+  Serial.flush();
+
+  return 0;
+}
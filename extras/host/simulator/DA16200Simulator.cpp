@@ -0,0 +1,1008 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include <Host.h>
+
+#include "DA16200Simulator.h"
+
+// time the module takes to restart, join a network and wake up, in microseconds
+#define SIM_RESTART_TIME 100000
+#define SIM_JOIN_TIME    200000
+#define SIM_WAKEUP_TIME  10000
+
+// addresses handed out to the board and used for the access point
+#define SIM_STATION_IP   "192.168.1.50"
+#define SIM_STATION_GW   "192.168.1.1"
+#define SIM_AP_IP        "10.0.0.1"
+#define SIM_NETMASK      "255.255.255.0"
+
+DA16200Simulator DA16200Sim(5, 2);
+HardwareSerial& Serial1 = DA16200Sim;
+
+static unsigned long envOr(const char* name, unsigned long value)
+{
+  const char* env = getenv(name);
+
+  return (env != NULL && *env != '\0') ? strtoul(env, NULL, 10) : value;
+}
+
+static std::string ipString(IPAddress ip)
+{
+  char buf[16];
+
+  sprintf(buf, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+
+  return buf;
+}
+
+DA16200Simulator::DA16200Simulator(int rtcWakePin, int wakeUpPin) :
+  _rtcWakePin(rtcWakePin),
+  _wakeUpPin(wakeUpPin),
+  _rtsPin(-1),
+  _ctsPin(-1),
+  _trace(envOr("DA16200_SIM_TRACE", 0) != 0),
+  _pumping(false),
+  _latency(envOr("DA16200_SIM_LATENCY", 500)),
+  _networkDelay(2000),
+  _scanTime(1500000),
+  _hostBaudRate(0),
+  _moduleBaudRate(envOr("DA16200_SIM_BAUDRATE", 115200)),
+  _maxBaudRate(envOr("DA16200_SIM_MAX_BAUDRATE", 921600)),
+  _pendingBaudRate(0),
+  _open(false),
+  _hardwareFlowControl(false),
+  _txFree(0),
+  _lineFree(0),
+  _overruns(0),
+  _ctsUntil(0),
+  _failSends(0),
+  _state(STATE_IDLE),
+  _escLength(0),
+  _arrival(0),
+  _replyTime(0),
+  _busyUntil(0),
+  _handling(false),
+  _baudRateAt(0),
+  _sleepAt(0),
+  _interface(0),
+  _mode(0),
+  _dpm(false),
+  _asleep(false),
+  _joined(false),
+  _clientConnected(false),
+  _clientPort(0),
+  _serverPort(0),
+  _udpPort(0),
+  _udpRemotePort(0)
+{
+  memset(_sendCounts, 0x00, sizeof(_sendCounts));
+  memset(_sendBytes, 0x00, sizeof(_sendBytes));
+
+  _onCommand.handler = NULL;
+  _onCommand.context = NULL;
+  _onSend.handler = NULL;
+  _onSend.context = NULL;
+
+  addNetwork("DA16200-Sim", -52, 6, "[WPA2-PSK-CCMP][ESS]");
+  addNetwork("Neighbour", -71, 1, "[WPA2-PSK-CCMP][ESS]");
+  addNetwork("Cafe", -80, 11, "[ESS]");
+
+  hostOnTick(DA16200Simulator::onTick, this);
+  hostOnPinWrite(DA16200Simulator::onPinWrite, this);
+}
+
+DA16200Simulator::~DA16200Simulator()
+{
+}
+
+void DA16200Simulator::setLatency(unsigned long latency)
+{
+  _latency = latency;
+}
+
+void DA16200Simulator::setNetworkDelay(unsigned long delay)
+{
+  _networkDelay = delay;
+}
+
+void DA16200Simulator::setScanTime(unsigned long scanTime)
+{
+  _scanTime = scanTime;
+}
+
+void DA16200Simulator::setModuleBaudRate(unsigned long baudrate)
+{
+  _moduleBaudRate = baudrate;
+}
+
+void DA16200Simulator::setMaxBaudRate(unsigned long baudrate)
+{
+  _maxBaudRate = baudrate;
+}
+
+void DA16200Simulator::flowControl(int rtsPin, int ctsPin)
+{
+  _rtsPin = rtsPin;
+  _ctsPin = ctsPin;
+
+  if (_ctsPin > -1) {
+    hostSetPin(_ctsPin, LOW);
+  }
+}
+
+void DA16200Simulator::trace(bool enable)
+{
+  _trace = enable;
+}
+
+void DA16200Simulator::onCommand(int (*handler)(void*, DA16200Simulator&, const char*), void* context)
+{
+  _onCommand.handler = handler;
+  _onCommand.context = context;
+}
+
+void DA16200Simulator::onSend(int (*handler)(void*, DA16200Simulator&, int, IPAddress, uint16_t, const uint8_t*, size_t), void* context)
+{
+  _onSend.handler = handler;
+  _onSend.context = context;
+}
+
+void DA16200Simulator::work(unsigned long duration)
+{
+  _replyTime += (uint64_t)duration * 1000;
+}
+
+void DA16200Simulator::reply(const char* text)
+{
+  schedule(_replyTime, text);
+}
+
+void DA16200Simulator::reply(int responseCode)
+{
+  char text[16];
+
+  if (responseCode == 0) {
+    strcpy(text, "OK\r\n");
+  } else {
+    sprintf(text, "ERROR:%d\r\n", responseCode);
+  }
+
+  reply(text);
+}
+
+void DA16200Simulator::emit(const char* text, unsigned long delay)
+{
+  emit((const uint8_t*)text, strlen(text), delay);
+}
+
+void DA16200Simulator::emit(const uint8_t* data, size_t size, unsigned long delay)
+{
+  // while handling a command, events follow its replies
+  uint64_t base = _handling ? _replyTime : hostMicros() * 1000;
+
+  schedule(base + (uint64_t)delay * 1000, std::string((const char*)data, size));
+}
+
+void DA16200Simulator::addNetwork(const char* ssid, int rssi, int channel, const char* flags)
+{
+  Network network;
+
+  network.ssid = ssid;
+  network.rssi = rssi;
+  network.channel = channel;
+  network.flags = flags;
+
+  // locally administered, unique per network
+  network.bssid[0] = 0x02;
+  network.bssid[1] = 0x16;
+  network.bssid[2] = 0x20;
+  network.bssid[3] = 0x00;
+  network.bssid[4] = 0x00;
+  network.bssid[5] = (uint8_t)(_networks.size() + 1);
+
+  _networks.push_back(network);
+}
+
+void DA16200Simulator::clearNetworks()
+{
+  _networks.clear();
+}
+
+void DA16200Simulator::addHost(const char* name, IPAddress ip)
+{
+  _hosts[name] = ip;
+}
+
+void DA16200Simulator::peerConnect(IPAddress ip, uint16_t port)
+{
+  char text[48];
+
+  sprintf(text, "+TRCTS:0,%s,%d\r\n", ipString(ip).c_str(), port);
+
+  emit(text);
+}
+
+void DA16200Simulator::peerDisconnect(IPAddress ip, uint16_t port)
+{
+  char text[48];
+
+  sprintf(text, "+TRXTS:0,%s,%d\r\n", ipString(ip).c_str(), port);
+
+  emit(text);
+}
+
+void DA16200Simulator::peerSend(IPAddress ip, uint16_t port, const uint8_t* data, size_t size)
+{
+  char header[64];
+
+  sprintf(header, "+TRDTS:0,%s,%d,%d,", ipString(ip).c_str(), port, (int)size);
+
+  std::string frame = std::string(header) + std::string((const char*)data, size);
+
+  emit((const uint8_t*)frame.data(), frame.size());
+}
+
+void DA16200Simulator::clientSend(const uint8_t* data, size_t size)
+{
+  char header[64];
+
+  sprintf(header, "+TRDTC:1,%s,%d,%d,", ipString(_clientIp).c_str(), _clientPort, (int)size);
+
+  std::string frame = std::string(header) + std::string((const char*)data, size);
+
+  emit((const uint8_t*)frame.data(), frame.size());
+}
+
+void DA16200Simulator::clientClose()
+{
+  char text[48];
+
+  sprintf(text, "+TRXTC:1,%s,%d\r\n", ipString(_clientIp).c_str(), _clientPort);
+
+  _clientConnected = false;
+
+  emit(text);
+}
+
+void DA16200Simulator::linkDown()
+{
+  std::string text = "+WFDAP:0,'" + _ssid + "'\r\n";
+
+  _joined = false;
+
+  emit(text.c_str());
+}
+
+void DA16200Simulator::holdCts(unsigned long duration)
+{
+  if (_ctsPin < 0) {
+    return;
+  }
+
+  hostSetPin(_ctsPin, HIGH);
+  _ctsUntil = hostMicros() * 1000 + (uint64_t)duration * 1000;
+}
+
+void DA16200Simulator::failSends(unsigned long count)
+{
+  _failSends = count;
+}
+
+unsigned long DA16200Simulator::commands()
+{
+  return _log.size();
+}
+
+unsigned long DA16200Simulator::commands(const char* prefix)
+{
+  unsigned long count = 0;
+
+  for (size_t i = 0; i < _log.size(); i++) {
+    if (_log[i].compare(0, strlen(prefix), prefix) == 0) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+unsigned long DA16200Simulator::sends(int cid)
+{
+  return (cid >= 0 && cid < 3) ? _sendCounts[cid] : 0;
+}
+
+unsigned long DA16200Simulator::bytesSent(int cid)
+{
+  return (cid >= 0 && cid < 3) ? _sendBytes[cid] : 0;
+}
+
+unsigned long DA16200Simulator::overruns()
+{
+  return _overruns;
+}
+
+unsigned long DA16200Simulator::baudRate()
+{
+  return _moduleBaudRate;
+}
+
+bool DA16200Simulator::asleep()
+{
+  return _asleep;
+}
+
+void DA16200Simulator::begin(unsigned long baudrate)
+{
+  pump();
+
+  _hostBaudRate = baudrate;
+  _open = true;
+  _rx.clear();
+}
+
+void DA16200Simulator::end()
+{
+  pump();
+
+  _open = false;
+  _rx.clear();
+}
+
+DA16200Simulator::operator bool()
+{
+  return _open;
+}
+
+int DA16200Simulator::available()
+{
+  pump();
+
+  return _rx.available();
+}
+
+int DA16200Simulator::read()
+{
+  pump();
+
+  return _rx.read_char();
+}
+
+int DA16200Simulator::peek()
+{
+  pump();
+
+  return _rx.peek();
+}
+
+size_t DA16200Simulator::write(uint8_t b)
+{
+  pump();
+
+  // blocks while the transmit FIFO is full, as the Arduino cores do
+  while (_tx.size() >= DA16200_SIM_SERIAL_TX_FIFO_SIZE) {
+    yield();
+    pump();
+  }
+
+  uint64_t now = hostMicros() * 1000;
+  Byte byte;
+
+  _txFree = ((_txFree > now) ? _txFree : now) + byteTime(_hostBaudRate);
+
+  byte.time = _txFree;
+  byte.value = b;
+  // at a different baud rate the module only sees noise
+  byte.valid = _open && _hostBaudRate == _moduleBaudRate;
+
+  _tx.push_back(byte);
+
+  return 1;
+}
+
+size_t DA16200Simulator::write(const uint8_t* buffer, size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    write(buffer[i]);
+  }
+
+  return size;
+}
+
+int DA16200Simulator::availableForWrite()
+{
+  pump();
+
+  return DA16200_SIM_SERIAL_TX_FIFO_SIZE - _tx.size();
+}
+
+void DA16200Simulator::flush()
+{
+  pump();
+
+  while (!_tx.empty()) {
+    yield();
+    pump();
+  }
+}
+
+void DA16200Simulator::onTick(void* context)
+{
+  ((DA16200Simulator*)context)->pump();
+}
+
+void DA16200Simulator::onPinWrite(void* context, int pin, int value)
+{
+  DA16200Simulator* sim = (DA16200Simulator*)context;
+
+  if (pin == sim->_rtcWakePin && value == HIGH && sim->_asleep) {
+    sim->wake();
+  }
+}
+
+void DA16200Simulator::pump()
+{
+  if (_pumping) {
+    return;
+  }
+
+  _pumping = true;
+
+  uint64_t now = hostMicros() * 1000;
+
+  while (!_tx.empty() && _tx.front().time <= now) {
+    Byte byte = _tx.front();
+
+    _tx.pop_front();
+    receive(byte.value, byte.valid, byte.time);
+  }
+
+  if (_ctsUntil != 0 && now >= _ctsUntil) {
+    _ctsUntil = 0;
+    hostSetPin(_ctsPin, LOW);
+  }
+
+  transmit(now);
+
+  _pumping = false;
+}
+
+void DA16200Simulator::transmit(uint64_t now)
+{
+  while (!_scheduled.empty() && _scheduled.begin()->first <= now) {
+    const std::string& data = _scheduled.begin()->second;
+
+    for (size_t i = 0; i < data.size(); i++) {
+      Byte byte;
+
+      byte.time = _scheduled.begin()->first;
+      byte.value = data[i];
+      byte.valid = true;
+
+      _out.push_back(byte);
+    }
+
+    _scheduled.erase(_scheduled.begin());
+  }
+
+  if (!_out.empty() && _asleep) {
+    // the module wakes up to deliver events, and signals the board on the wake up pin
+    _asleep = false;
+    hostSetPin(_wakeUpPin, LOW);
+    hostSetPin(_wakeUpPin, HIGH);
+  }
+
+  while (!_out.empty()) {
+    if (_hardwareFlowControl && _rtsPin > -1 && digitalRead(_rtsPin) == HIGH) {
+      // the board asked the module to hold off
+      if (_lineFree < now) {
+        _lineFree = now;
+      }
+      break;
+    }
+
+    uint64_t start = (_out.front().time > _lineFree) ? _out.front().time : _lineFree;
+    uint64_t end = start + byteTime(_moduleBaudRate);
+
+    if (end > now) {
+      break;
+    }
+
+    uint8_t value = _out.front().value;
+
+    _out.pop_front();
+    _lineFree = end;
+
+    if (!_open || _hostBaudRate != _moduleBaudRate) {
+      continue;
+    }
+
+    if (_rx.isFull()) {
+      _overruns++;
+    } else {
+      _rx.store_char(value);
+    }
+  }
+
+  if (!_out.empty()) {
+    return;
+  }
+
+  if (_pendingBaudRate != 0 && now >= _baudRateAt) {
+    // switch once the response to the request has been sent at the old rate
+    _moduleBaudRate = _pendingBaudRate;
+    _pendingBaudRate = 0;
+  }
+
+  if (_sleepAt != 0 && now >= _sleepAt) {
+    _sleepAt = 0;
+    _asleep = true;
+  }
+}
+
+uint64_t DA16200Simulator::byteTime(unsigned long baudrate)
+{
+  // start, 8 data and stop bits
+  return (baudrate != 0) ? (10ULL * 1000000000ULL) / baudrate : 0;
+}
+
+void DA16200Simulator::receive(uint8_t c, bool valid, uint64_t time)
+{
+  if (_asleep) {
+    // the serial port of the module is off
+    return;
+  }
+
+  if (!valid) {
+    _state = STATE_IDLE;
+    return;
+  }
+
+  _arrival = time;
+
+  switch (_state) {
+    case STATE_IDLE:
+      if (c == 'A') {
+        _state = STATE_A;
+      } else if (c == '\e') {
+        _state = STATE_ESC;
+      }
+      break;
+
+    case STATE_A:
+      if (c == 'T') {
+        _command.clear();
+        _state = STATE_COMMAND;
+      } else {
+        _state = (c == 'A') ? STATE_A : STATE_IDLE;
+      }
+      break;
+
+    case STATE_COMMAND:
+      if (c == '\n') {
+        _state = STATE_IDLE;
+        handleCommand(_command.c_str());
+      } else if (c != '\r') {
+        _command += (char)c;
+      }
+      break;
+
+    case STATE_ESC:
+      if (c == 'S') {
+        _escHeader.clear();
+        _escPayload.clear();
+        _state = STATE_ESC_HEADER;
+      } else {
+        _state = STATE_IDLE;
+        handleCommand("\e?");
+      }
+      break;
+
+    case STATE_ESC_HEADER:
+      _escHeader += (char)c;
+
+      // <cid><length>,<ip>,<port>,
+      if (c == ',' && std::count(_escHeader.begin(), _escHeader.end(), ',') == 3) {
+        _escLength = strtoul(_escHeader.c_str() + 1, NULL, 10);
+        _state = STATE_ESC_PAYLOAD;
+
+        if (_escLength == 0) {
+          _state = STATE_IDLE;
+          handleSend();
+        }
+      } else if (_escHeader.size() > 32) {
+        _state = STATE_IDLE;
+      }
+      break;
+
+    case STATE_ESC_PAYLOAD:
+      _escPayload.push_back(c);
+
+      if (_escPayload.size() >= _escLength) {
+        _state = STATE_IDLE;
+        handleSend();
+      }
+      break;
+  }
+}
+
+void DA16200Simulator::handleCommand(const char* command)
+{
+  uint64_t ready = _arrival + (uint64_t)_latency * 1000;
+
+  // the module handles one command at a time
+  _replyTime = (ready > _busyUntil) ? ready : _busyUntil;
+  _handling = true;
+
+  _log.push_back(command);
+
+  if (_trace) {
+    traceText("> AT", command);
+  }
+
+  if (_onCommand.handler == NULL || !_onCommand.handler(_onCommand.context, *this, command)) {
+    handleDefault(command);
+  }
+
+  _handling = false;
+  _busyUntil = _replyTime;
+}
+
+void DA16200Simulator::handleDefault(const char* command)
+{
+  static const char* const okCommands[] = {
+    "", "Z", "+WFDIS", "+TRTALL", "+NWSNTP", "+MCUWUDONE", "+CLRDPMSLPEXT",
+    "+NWDHC", "+NWDHS", "+NWDNS", "+WFAPCH", "+WFSAP", "+TRSAVE"
+  };
+
+  std::string name = command;
+  std::string args;
+  size_t equals = name.find('=');
+
+  if (equals != std::string::npos) {
+    args = name.substr(equals + 1);
+    name = name.substr(0, equals);
+  }
+
+  for (size_t i = 0; i < sizeof(okCommands) / sizeof(okCommands[0]); i++) {
+    if (name == okCommands[i]) {
+      reply(0);
+      return;
+    }
+  }
+
+  char text[256];
+
+  if (name == "B") {
+    unsigned long baudrate = strtoul(args.c_str(), NULL, 10);
+
+    if (baudrate == 0 || baudrate > _maxBaudRate) {
+      reply(-1);
+      return;
+    }
+
+    reply(0);
+
+    _hardwareFlowControl = (args.size() > 2 && args.compare(args.size() - 2, 2, ",h") == 0);
+
+    if (baudrate != _moduleBaudRate) {
+      _pendingBaudRate = baudrate;
+      _baudRateAt = _replyTime;
+    }
+  } else if (name == "+WFMODE") {
+    _mode = atoi(args.c_str());
+    reply(0);
+  } else if (name == "+RESTART") {
+    reply(0);
+    restart(_mode, SIM_RESTART_TIME);
+  } else if (name == "+DEFAP") {
+    _mode = 1;
+    reply(0);
+    restart(1, SIM_RESTART_TIME);
+  } else if (name == "+DPM") {
+    _dpm = (atoi(args.c_str()) == 1);
+    reply(0);
+    restart(_mode, SIM_RESTART_TIME);
+  } else if (name == "+SETDPMSLPEXT") {
+    reply(0);
+
+    if (_dpm) {
+      _sleepAt = _replyTime;
+    }
+  } else if (name == "+WFQAP" || name == "+WFTAP") {
+    _joined = false;
+    reply(0);
+  } else if (name == "+WFJAPA" || name == "+WFJAP") {
+    size_t start = args.find('\'');
+    size_t end = (start != std::string::npos) ? args.find('\'', start + 1) : std::string::npos;
+
+    if (end == std::string::npos) {
+      reply(-1);
+      return;
+    }
+
+    _ssid = args.substr(start + 1, end - start - 1);
+    _joined = true;
+
+    reply(0);
+
+    std::string event = "+WFJAP:1,'" + _ssid + "'," SIM_STATION_IP "\r\n";
+
+    emit(event.c_str(), SIM_JOIN_TIME);
+  } else if (name == "+WFSCAN") {
+    std::string response = "+WFSCAN:";
+
+    for (size_t i = 0; i < _networks.size(); i++) {
+      const Network& network = _networks[i];
+      int frequency = (network.channel == 14) ? 2484 : (2407 + 5 * network.channel);
+
+      sprintf(
+        text, "%02x:%02x:%02x:%02x:%02x:%02x\t%d\t%d\t%s\t%s\n",
+        network.bssid[0], network.bssid[1], network.bssid[2], network.bssid[3], network.bssid[4], network.bssid[5],
+        frequency, network.rssi, network.flags.c_str(), network.ssid.c_str()
+      );
+
+      response += text;
+    }
+
+    if (!_networks.empty()) {
+      response.erase(response.size() - 1);
+    }
+    response += "\r\n";
+
+    work(_scanTime);
+    reply(response.c_str());
+    reply(0);
+  } else if (name == "+NWHOST") {
+    IPAddress ip;
+    std::map<std::string, IPAddress>::iterator host = _hosts.find(args);
+
+    work(_networkDelay);
+
+    if (host != _hosts.end()) {
+      ip = host->second;
+    } else if (!ip.fromString(args.c_str())) {
+      reply(-1);
+      return;
+    }
+
+    sprintf(text, "+NWHOST:%s\r\n", ipString(ip).c_str());
+    reply(text);
+    reply(0);
+  } else if (name == "+NWIP") {
+    if (args == "?") {
+      if (_interface == 1) {
+        sprintf(text, "+NWIP:1,%s,%s,%s\r\n", SIM_AP_IP, SIM_NETMASK, SIM_AP_IP);
+      } else {
+        sprintf(text, "+NWIP:0,%s,%s,%s\r\n", _joined ? SIM_STATION_IP : "0.0.0.0", SIM_NETMASK, _joined ? SIM_STATION_GW : "0.0.0.0");
+      }
+      reply(text);
+    }
+
+    reply(0);
+  } else if (name == "+NWPING") {
+    int roundTrip = (int)((2 * _networkDelay) / 1000);
+
+    if (roundTrip < 1) {
+      roundTrip = 1;
+    }
+
+    work(2 * _networkDelay);
+    sprintf(text, "+NWPING:1,%d,%d,%d,%d\r\n", _joined ? 1 : 0, roundTrip, roundTrip, roundTrip);
+    reply(text);
+    reply(0);
+  } else if (name == "+TIME" && args == "?") {
+    time_t now = time(NULL);
+    struct tm* tm = gmtime(&now);
+
+    sprintf(
+      text, "+TIME:%04d-%02d-%02d,%02d:%02d:%02d\r\n",
+      tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
+      tm->tm_hour, tm->tm_min, tm->tm_sec
+    );
+    reply(text);
+    reply(0);
+  } else if (name == "+WFMAC" && args == "?") {
+    reply("+WFMAC:02:16:20:0A:0B:0C\r\n");
+    reply(0);
+  } else if (name == "+SDKVER") {
+    reply("+SDKVER:3.1.2.0\r\n");
+    reply(0);
+  } else if (name == "+WFRSSI") {
+    if (!_joined) {
+      reply(-1);
+      return;
+    }
+
+    sprintf(text, "+RSSI:%d\r\n", _networks.empty() ? -52 : _networks[0].rssi);
+    reply(text);
+    reply(0);
+  } else if (name == "+WFSTAT") {
+    if (_joined) {
+      sprintf(
+        text, "+WFSTAT:softap%d\nbssid=02:16:20:00:00:01\nssid=%s\nkey_mgmt=WPA2-PSK\nwpa_state=COMPLETED\r\n",
+        _interface, _ssid.c_str()
+      );
+    } else {
+      sprintf(text, "+WFSTAT:softap%d\nwpa_state=DISCONNECTED\r\n", _interface);
+    }
+    reply(text);
+    reply(0);
+  } else if (name == "+TRTC") {
+    int octets[4] = { 0, 0, 0, 0 };
+    int port = 0;
+
+    if (sscanf(args.c_str(), "%d.%d.%d.%d,%d", &octets[0], &octets[1], &octets[2], &octets[3], &port) != 5 || !_joined) {
+      reply(-1);
+      return;
+    }
+
+    _clientIp = IPAddress(octets[0], octets[1], octets[2], octets[3]);
+    _clientPort = port;
+    _clientConnected = true;
+
+    // the three way handshake
+    work(_networkDelay * 3 / 2);
+    reply("+TRTC:1\r\n");
+    reply(0);
+  } else if (name == "+TRTS") {
+    _serverPort = atoi(args.c_str());
+    reply("+TRTS:0\r\n");
+    reply(0);
+  } else if (name == "+TRUSE") {
+    _udpPort = atoi(args.c_str());
+    reply("+TRUSE:2\r\n");
+    reply(0);
+  } else if (name == "+TRUR") {
+    int octets[4] = { 0, 0, 0, 0 };
+    int port = 0;
+
+    sscanf(args.c_str(), "%d.%d.%d.%d,%d", &octets[0], &octets[1], &octets[2], &octets[3], &port);
+
+    _udpIp = IPAddress(octets[0], octets[1], octets[2], octets[3]);
+    _udpRemotePort = port;
+    reply(0);
+  } else if (name == "+TRTRM") {
+    int cid = atoi(args.c_str());
+
+    if (cid == 0) {
+      _serverPort = 0;
+    } else if (cid == 1) {
+      _clientConnected = false;
+    } else if (cid == 2) {
+      _udpPort = 0;
+    }
+    reply(0);
+  } else {
+    reply(-1);
+  }
+}
+
+void DA16200Simulator::handleSend()
+{
+  int cid = _escHeader[0] - '0';
+  int octets[4] = { 0, 0, 0, 0 };
+  int port = 0;
+  size_t comma = _escHeader.find(',');
+
+  sscanf(_escHeader.c_str() + comma + 1, "%d.%d.%d.%d,%d", &octets[0], &octets[1], &octets[2], &octets[3], &port);
+
+  IPAddress ip(octets[0], octets[1], octets[2], octets[3]);
+  uint64_t ready = _arrival + (uint64_t)_latency * 1000;
+
+  _replyTime = (ready > _busyUntil) ? ready : _busyUntil;
+  _handling = true;
+
+  _log.push_back("\eS" + _escHeader);
+
+  if (_trace) {
+    traceText("> \\eS", _escHeader);
+  }
+
+  // the payload goes out at the module's own pace
+  work((_escPayload.size() * 8) / 10);
+
+  if (cid < 0 || cid > 2 || (cid == 1 && !_clientConnected) || (cid == 2 && _udpPort == 0)) {
+    reply(-1);
+  } else if (_failSends > 0) {
+    _failSends--;
+    reply(-1);
+  } else {
+    _sendCounts[cid]++;
+    _sendBytes[cid] += _escPayload.size();
+
+    reply(0);
+
+    if (_onSend.handler == NULL || !_onSend.handler(_onSend.context, *this, cid, ip, port, _escPayload.data(), _escPayload.size())) {
+      char header[64];
+
+      // echo servers on the other end of the client and UDP sockets
+      if (cid == 1) {
+        sprintf(header, "+TRDTC:1,%s,%d,%d,", ipString(_clientIp).c_str(), _clientPort, (int)_escPayload.size());
+      } else if (cid == 2) {
+        if ((uint32_t)ip == 0) {
+          ip = _udpIp;
+          port = _udpRemotePort;
+        }
+
+        sprintf(header, "+TRDUS:2,%s,%d,%d,", ipString(ip).c_str(), port, (int)_escPayload.size());
+      }
+
+      if (cid != 0) {
+        std::string frame = std::string(header) + std::string((const char*)_escPayload.data(), _escPayload.size());
+
+        emit((const uint8_t*)frame.data(), frame.size(), 2 * _networkDelay);
+      }
+    }
+  }
+
+  _handling = false;
+  _busyUntil = _replyTime;
+}
+
+void DA16200Simulator::schedule(uint64_t time, const std::string& data)
+{
+  _scheduled.insert(std::make_pair(time, data));
+
+  if (_trace) {
+    traceText("< ", data);
+  }
+}
+
+void DA16200Simulator::restart(int interface, unsigned long delay)
+{
+  char text[32];
+
+  _interface = interface;
+  _joined = false;
+  _clientConnected = false;
+  _serverPort = 0;
+  _udpPort = 0;
+
+  sprintf(text, "+INIT:DONE,%d%s\r\n", interface, _dpm ? ",DPM" : "");
+
+  emit(text, delay);
+}
+
+void DA16200Simulator::wake()
+{
+  _asleep = false;
+  _sleepAt = 0;
+
+  emit("+INIT:WAKEUP,UC\r\n", SIM_WAKEUP_TIME);
+}
+
+void DA16200Simulator::traceText(const char* prefix, const std::string& text)
+{
+  fprintf(stderr, "[%10.3f] %s", hostMicros() / 1000.0, prefix);
+
+  for (size_t i = 0; i < text.size() && i < 96; i++) {
+    unsigned char c = text[i];
+
+    if (c == '\r') {
+      fputs("\\r", stderr);
+    } else if (c == '\n') {
+      fputs("\\n", stderr);
+    } else if (c < 0x20 || c >= 0x7f) {
+      fprintf(stderr, "\\x%02x", c);
+    } else {
+      fputc(c, stderr);
+    }
+  }
+
+  if (text.size() > 96) {
+    fputs("...", stderr);
+  }
+
+  fputc('\n', stderr);
+}
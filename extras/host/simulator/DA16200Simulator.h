@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ *
+ */
+
+#ifndef _DA16200_SIMULATOR_H_
+#define _DA16200_SIMULATOR_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+// size of the receive buffer of the simulated serial port, as in the Arduino cores
+#ifndef DA16200_SIM_SERIAL_BUFFER_SIZE
+#define DA16200_SIM_SERIAL_BUFFER_SIZE 256
+#endif
+
+// size of the transmit FIFO of the simulated serial port
+#ifndef DA16200_SIM_SERIAL_TX_FIFO_SIZE
+#define DA16200_SIM_SERIAL_TX_FIFO_SIZE 64
+#endif
+
+// a scripted DA16200 module behind a serial port, timed at the configured baud rate
+//
+// it is the serial port the library talks to, bytes written to it reach the module after their
+// transmit time, are parsed as AT commands and ESC sequences and answered with the responses
+// and events of the module, each byte of which becomes available after its transmit time
+//
+// the defaults can be changed with environment variables:
+//   DA16200_SIM_LATENCY       microseconds between a command arriving and its response
+//   DA16200_SIM_BAUDRATE      baud rate the module starts at
+//   DA16200_SIM_MAX_BAUDRATE  highest baud rate the module accepts
+//   DA16200_SIM_TRACE         1 to log commands and responses to stderr
+class DA16200Simulator : public HardwareSerial {
+  public:
+    DA16200Simulator(int rtcWakePin, int wakeUpPin);
+    virtual ~DA16200Simulator();
+
+    // simulation settings
+    void setLatency(unsigned long latency);
+    void setNetworkDelay(unsigned long delay);
+    void setScanTime(unsigned long scanTime);
+    void setModuleBaudRate(unsigned long baudrate);
+    void setMaxBaudRate(unsigned long baudrate);
+    void flowControl(int rtsPin, int ctsPin);
+    void trace(bool enable);
+
+    // scripting, the handler returns 1 if it answered the command (without the "AT" prefix)
+    // itself with reply() and 0 for the default behavior
+    void onCommand(int (*handler)(void*, DA16200Simulator&, const char*), void* context);
+    // called for each ESC "S" send, return 1 to suppress the default echo
+    void onSend(int (*handler)(void*, DA16200Simulator&, int, IPAddress, uint16_t, const uint8_t*, size_t), void* context);
+
+    // within a command handler: wait before the following replies, and queue a reply
+    void work(unsigned long duration);
+    void reply(const char* text);
+    void reply(int responseCode);
+
+    // unsolicited output, delay microseconds from now
+    void emit(const char* text, unsigned long delay = 0);
+    void emit(const uint8_t* data, size_t size, unsigned long delay = 0);
+
+    void addNetwork(const char* ssid, int rssi, int channel, const char* flags);
+    void clearNetworks();
+    void addHost(const char* name, IPAddress ip);
+
+    // events of the server socket and the client socket
+    void peerConnect(IPAddress ip, uint16_t port);
+    void peerDisconnect(IPAddress ip, uint16_t port);
+    void peerSend(IPAddress ip, uint16_t port, const uint8_t* data, size_t size);
+    void clientSend(const uint8_t* data, size_t size);
+    void clientClose();
+    void linkDown();
+
+    // holds CTS high for duration microseconds, as if the module can not take more data
+    void holdCts(unsigned long duration);
+    // answers the next count ESC "S" sends with an error, as if the module is out of buffers
+    void failSends(unsigned long count);
+
+    // statistics
+    unsigned long commands();
+    unsigned long commands(const char* prefix);
+    unsigned long sends(int cid);
+    unsigned long bytesSent(int cid);
+    unsigned long overruns();
+    unsigned long baudRate();
+    bool asleep();
+
+    // from HardwareSerial
+    virtual void begin(unsigned long baudrate);
+    virtual void end();
+    virtual operator bool();
+
+    // from Stream
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+
+    // from Print
+    virtual size_t write(uint8_t b);
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    virtual int availableForWrite();
+    virtual void flush();
+
+    using Print::write;
+
+  private:
+    struct Byte {
+      uint64_t time;
+      uint8_t value;
+      bool valid;
+    };
+
+    static void onTick(void* context);
+    static void onPinWrite(void* context, int pin, int value);
+
+    void pump();
+    void receive(uint8_t c, bool valid, uint64_t time);
+    void transmit(uint64_t now);
+    uint64_t byteTime(unsigned long baudrate);
+
+    void handleCommand(const char* command);
+    void handleDefault(const char* command);
+    void handleSend();
+    void schedule(uint64_t time, const std::string& data);
+    void restart(int interface, unsigned long delay);
+    void wake();
+    void traceText(const char* prefix, const std::string& text);
+
+  private:
+    enum {
+      STATE_IDLE,
+      STATE_A,
+      STATE_COMMAND,
+      STATE_ESC,
+      STATE_ESC_HEADER,
+      STATE_ESC_PAYLOAD
+    };
+
+    struct Network {
+      std::string ssid;
+      int rssi;
+      int channel;
+      std::string flags;
+      uint8_t bssid[6];
+    };
+
+    int _rtcWakePin;
+    int _wakeUpPin;
+    int _rtsPin;
+    int _ctsPin;
+    bool _trace;
+    bool _pumping;
+
+    unsigned long _latency;
+    unsigned long _networkDelay;
+    unsigned long _scanTime;
+    unsigned long _hostBaudRate;
+    unsigned long _moduleBaudRate;
+    unsigned long _maxBaudRate;
+    unsigned long _pendingBaudRate;
+    bool _open;
+    bool _hardwareFlowControl;
+
+    // host to module, bytes still in flight in the transmit FIFO
+    std::deque<Byte> _tx;
+    uint64_t _txFree;
+
+    // module to host, output not sent yet and the receive buffer of the serial port,
+    // times are in nanoseconds of hostMicros()
+    std::multimap<uint64_t, std::string> _scheduled;
+    std::deque<Byte> _out;
+    uint64_t _lineFree;
+    RingBufferN<DA16200_SIM_SERIAL_BUFFER_SIZE> _rx;
+    unsigned long _overruns;
+    uint64_t _ctsUntil;
+    unsigned long _failSends;
+
+    // command processing, commands are answered one at a time
+    int _state;
+    std::string _command;
+    std::string _escHeader;
+    std::vector<uint8_t> _escPayload;
+    size_t _escLength;
+    uint64_t _arrival;
+    uint64_t _replyTime;
+    uint64_t _busyUntil;
+    bool _handling;
+    uint64_t _baudRateAt;
+    uint64_t _sleepAt;
+
+    // module state
+    int _interface;
+    int _mode;
+    bool _dpm;
+    bool _asleep;
+    bool _joined;
+    std::string _ssid;
+    bool _clientConnected;
+    IPAddress _clientIp;
+    uint16_t _clientPort;
+    int _serverPort;
+    int _udpPort;
+    IPAddress _udpIp;
+    uint16_t _udpRemotePort;
+
+    std::vector<Network> _networks;
+    std::map<std::string, IPAddress> _hosts;
+    std::vector<std::string> _log;
+    unsigned long _sendCounts[3];
+    unsigned long _sendBytes[3];
+
+    struct {
+      int (*handler)(void*, DA16200Simulator&, const char*);
+      void* context;
+    } _onCommand;
+
+    struct {
+      int (*handler)(void*, DA16200Simulator&, int, IPAddress, uint16_t, const uint8_t*, size_t);
+      void* context;
+    } _onSend;
+};
+
+extern DA16200Simulator DA16200Sim;
+
+#endif
@@ -0,0 +1,35 @@
+#
+# Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+#
+# SPDX-License-Identifier: LGPL-2.1
+#
+
+# turns a sketch into C++ the way the Arduino IDE does, by declaring its functions ahead of
+# the first function definition, run as: awk -f sketch.awk Sketch.ino Sketch.ino
+
+function isDefinition(line) {
+  return line ~ /^([A-Za-z_][A-Za-z0-9_:<>]*[ \t*&]+)+[A-Za-z_][A-Za-z0-9_]*[ \t]*\([^;]*\)[ \t]*\{[ \t]*$/ &&
+         line !~ /^(else|return|if|for|while|switch)[ \t(]/
+}
+
+FNR == NR {
+  if (isDefinition($0)) {
+    prototype = $0
+    sub(/[ \t]*\{[ \t]*$/, ";", prototype)
+    prototypes = prototypes prototype "\n"
+  }
+  next
+}
+
+FNR == 1 {
+  printf "#line 1 \"%s\"\n", FILENAME
+}
+
+!declared && isDefinition($0) {
+  printf "%s#line %d \"%s\"\n", prototypes, FNR, FILENAME
+  declared = 1
+}
+
+{
+  print
+}
@@ -0,0 +1,63 @@
+/*
+ *  Socket receive buffer pool
+ *
+ *  Checks that a WiFiServer and a WiFiClient can be open at once with the default pool,
+ *  the client making do with the room the server leaves, and that a socket that does not
+ *  fit at all fails to open until another socket, such as the server, is stopped.
+ *
+ *  Host test, see extras/host/README.md.
+ *
+ *  Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ *  SPDX-License-Identifier: LGPL-2.1
+ */
+
+#include <DA16200_WiFi.h>
+#include <WiFiUdp.h>
+#include <DA16200Simulator.h>
+
+WiFiServer server(80);
+WiFiClient client;
+WiFiUDP udp;
+uint8_t data[1000];
+
+void check(const char* name, bool ok) {
+  Serial.print(ok ? "PASS " : "FAIL ");
+  Serial.println(name);
+}
+
+void setup() {
+  memset(data, 'x', sizeof(data));
+
+  check("begin", WiFi.begin("DA16200-Sim", "password") == WL_CONNECTED);
+
+  server.begin();
+  check("client connects while the server is open", client.connect(IPAddress(192, 168, 1, 1), 7) == 1);
+
+  // the simulated server echoes what the client sends
+  client.write(data, sizeof(data));
+
+  int count = 0;
+
+  for (unsigned long start = millis(); (millis() - start) < 500;) {
+    if (client.read() != -1) {
+      count++;
+    }
+  }
+
+  check("client receives into the smaller buffer", count == sizeof(data) && client.droppedBytes() == 0);
+  check("no room left for a UDP socket", udp.begin(5000) == 0);
+
+  client.stop();
+  check("UDP socket opens once the client is stopped", udp.begin(5000) == 1);
+  check("no room left for the client", client.connect(IPAddress(192, 168, 1, 1), 7) == 0);
+
+  server.stop();
+  check("client connects once the server is stopped", client.connect(IPAddress(192, 168, 1, 1), 7) == 1);
+
+  client.stop();
+  udp.stop();
+}
+
+void loop() {
+}
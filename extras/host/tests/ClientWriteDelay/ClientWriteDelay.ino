@@ -0,0 +1,92 @@
+/*
+ *  WiFiClient writes held back with setNoDelay(false)
+ *
+ *  Checks that small writes are sent once the write delay has passed while the sketch
+ *  only calls connected(), and that data the module refuses stays buffered and goes out
+ *  with the next flush instead of being dropped.
+ *
+ *  Host test, see extras/host/README.md.
+ *
+ *  Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ *  SPDX-License-Identifier: LGPL-2.1
+ */
+
+#include <DA16200_WiFi.h>
+#include <DA16200Simulator.h>
+
+WiFiClient client;
+IPAddress echoServer(192, 168, 1, 60);
+
+void check(const char* name, bool ok) {
+  Serial.print(ok ? "PASS " : "FAIL ");
+  Serial.println(name);
+}
+
+String readEcho(size_t length, unsigned long timeout) {
+  String echo;
+
+  for (unsigned long start = millis(); echo.length() < length && (millis() - start) < timeout;) {
+    int c = client.read();
+
+    if (c != -1) {
+      echo += (char)c;
+    }
+  }
+
+  return echo;
+}
+
+void setup() {
+  check("begin", WiFi.begin("DA16200-Sim", "password") == WL_CONNECTED);
+  check("connect", client.connect(echoServer, 7));
+
+  client.setNoDelay(false);
+
+  unsigned long sends = DA16200Sim.sends(1);
+
+  client.print("ping");
+  client.print("pong");
+  check("writes are held back", DA16200Sim.sends(1) == sends);
+
+  // only connected() polls, the held back writes go out once the delay has passed
+  for (unsigned long start = millis(); (millis() - start) < 100;) {
+    client.connected();
+  }
+
+  check("held back writes sent from connected()", DA16200Sim.sends(1) == sends + 1);
+  check("held back writes echoed as one", readEcho(8, 500) == "pingpong");
+
+  // the module refuses the first send, the data is kept for the next try
+  sends = DA16200Sim.sends(1);
+  DA16200Sim.failSends(1);
+
+  client.print("hello");
+  client.flush();
+  check("refused write reported", client.getWriteError() != 0);
+  check("refused write not sent", DA16200Sim.sends(1) == sends);
+
+  client.clearWriteError();
+  client.flush();
+  check("refused write sent with the next flush", DA16200Sim.sends(1) == sends + 1);
+  check("refused write echoed", readEcho(5, 500) == "hello");
+
+  // a write that does not fit sends the held back data together with it
+  uint8_t data[300];
+
+  memset(data, 'x', sizeof(data));
+  sends = DA16200Sim.sends(1);
+  DA16200Sim.failSends(1);
+
+  client.print("head");
+  check("gather write refused", client.write(data, sizeof(data)) == 0);
+
+  client.clearWriteError();
+  client.flush();
+  check("held back data kept after a refused gather write", readEcho(4, 500) == "head");
+
+  client.stop();
+}
+
+void loop() {
+}
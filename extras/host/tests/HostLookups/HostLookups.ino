@@ -0,0 +1,71 @@
+/*
+ *  WiFi.beginHostByName() lookups that lose their response
+ *
+ *  Checks that a lookup whose response was answered and recycled by newer commands before
+ *  the next poll asks the module once more instead of failing, and that hostnames too long
+ *  for the cache are still resolved by WiFi.hostByName().
+ *
+ *  Host test, see extras/host/README.md.
+ *
+ *  Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ *  SPDX-License-Identifier: LGPL-2.1
+ */
+
+#include <DA16200_WiFi.h>
+#include <DA16200Simulator.h>
+
+#define LONG_HOSTNAME "a-hostname-that-is-longer-than-the-sixty-three-characters-of-the-cache.example"
+
+int lookups = 0;
+
+int noAddressFirst(void*, DA16200Simulator& sim, const char* command) {
+  if (strcmp(command, "+NWHOST=late.example") != 0) {
+    return 0;
+  }
+
+  // the module has no address yet on the first lookup
+  if (lookups++ == 0) {
+    sim.reply("+NWHOST:0.0.0.0\r\n");
+  } else {
+    sim.reply("+NWHOST:10.0.0.2\r\n");
+  }
+  sim.reply(0);
+
+  return 1;
+}
+
+void check(const char* name, bool ok) {
+  Serial.print(ok ? "PASS " : "FAIL ");
+  Serial.println(name);
+}
+
+void setup() {
+  check("begin", WiFi.begin("DA16200-Sim", "password") == WL_CONNECTED);
+
+  DA16200Sim.onCommand(noAddressFirst, NULL);
+
+  int handle = WiFi.beginHostByName("late.example");
+
+  // the lookup's response is answered and recycled before the lookups are polled again
+  for (int i = 0; i < 5; i++) {
+    WiFi.AT();
+  }
+
+  IPAddress result;
+  int resolved = 0;
+
+  for (unsigned long start = millis(); resolved == 0 && (millis() - start) < 5000;) {
+    resolved = WiFi.checkHostByName(handle, result);
+  }
+
+  check("lookup with a lost response asks again", resolved == 1 && result == IPAddress(10, 0, 0, 2) && lookups == 2);
+
+  DA16200Sim.addHost(LONG_HOSTNAME, IPAddress(10, 0, 0, 3));
+
+  check("long hostname not started in the background", WiFi.beginHostByName(LONG_HOSTNAME) == 0);
+  check("long hostname resolved", WiFi.hostByName(LONG_HOSTNAME, result) == 1 && result == IPAddress(10, 0, 0, 3));
+}
+
+void loop() {
+}
@@ -0,0 +1,98 @@
+/*
+ *  Scan results
+ *
+ *  Checks that a scan with more networks than WIFI_SCAN_MAX_NETWORKS keeps the strongest
+ *  ones in order, and that scans filtered by name, scans without results and scans started
+ *  with beginScanNetworks() report the networks of their own scan only, that a scan queued
+ *  behind slow commands is not given up on, and that a scan that can not start leaves the
+ *  status alone.
+ *
+ *  Host test, see extras/host/README.md.
+ *
+ *  Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ *  SPDX-License-Identifier: LGPL-2.1
+ */
+
+#include <DA16200_WiFi.h>
+#include <DA16200Simulator.h>
+
+int slowLookups(void*, DA16200Simulator& sim, const char* command) {
+  if (strncmp(command, "+NWHOST=", 8) != 0) {
+    return 0;
+  }
+
+  sim.work(3000000);
+  sim.reply("+NWHOST:10.0.0.1\r\n");
+  sim.reply(0);
+
+  return 1;
+}
+
+void check(const char* name, bool ok) {
+  Serial.print(ok ? "PASS " : "FAIL ");
+  Serial.println(name);
+}
+
+void setup() {
+  char ssid[16];
+
+  DA16200Sim.clearNetworks();
+
+  for (int i = 0; i < WIFI_SCAN_MAX_NETWORKS + 8; i++) {
+    sprintf(ssid, "Network %d", i);
+    DA16200Sim.addNetwork(ssid, -90 + i, 1 + (i % 11), "[WPA2-PSK-CCMP][ESS]");
+  }
+
+  int8_t count = WiFi.scanNetworks();
+
+  check("table full", count == WIFI_SCAN_MAX_NETWORKS);
+
+  bool sorted = true;
+
+  for (int i = 1; i < count; i++) {
+    sorted = sorted && (WiFi.RSSI(i - 1) >= WiFi.RSSI(i));
+  }
+
+  sprintf(ssid, "Network %d", WIFI_SCAN_MAX_NETWORKS + 7);
+  check("strongest first", sorted && strcmp(WiFi.SSID(0), ssid) == 0 && WiFi.RSSI(0) == -90 + WIFI_SCAN_MAX_NETWORKS + 7);
+  check("encryption parsed", WiFi.encryptionType(0) == ENC_TYPE_CCMP);
+
+  check("filtered by name", WiFi.scanNetworks("Network 3") == 1 && strcmp(WiFi.SSID(0), "Network 3") == 0);
+
+  DA16200Sim.clearNetworks();
+  check("no networks", WiFi.scanNetworks() == 0);
+
+  DA16200Sim.addNetwork("Cafe", -80, 11, "[ESS]");
+  WiFi.beginScanNetworks();
+
+  int8_t result;
+
+  while ((result = WiFi.scanComplete()) == WL_SCAN_RUNNING) {
+  }
+
+  check("background scan", result == 1 && strcmp(WiFi.SSID(0), "Cafe") == 0 && WiFi.encryptionType(0) == ENC_TYPE_NONE);
+
+  // the scan's time starts once the module gets to it, not when it is queued
+  DA16200Sim.onCommand(slowLookups, NULL);
+  WiFi.beginHostByName("first.example");
+  WiFi.beginHostByName("second.example");
+  WiFi.beginScanNetworks();
+
+  while ((result = WiFi.scanComplete()) == WL_SCAN_RUNNING) {
+  }
+
+  check("scan behind slow commands", result == 1);
+  DA16200Sim.onCommand(NULL, NULL);
+
+  // a second scan can not start while one is running
+  check("connected", WiFi.begin("DA16200-Sim", "password") == WL_CONNECTED);
+  WiFi.beginScanNetworks();
+  check("scan not started", WiFi.scanNetworks() == -1 && WiFi.status() == WL_CONNECTED);
+
+  while (WiFi.scanComplete() == WL_SCAN_RUNNING) {
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,105 @@
+/*
+ *  WiFiServer receive queues
+ *
+ *  Checks that a single client can receive frames larger than WIFI_SOCKET_PEER_BUFFER_SIZE,
+ *  that several clients share the server buffer, and that every one of
+ *  WIFI_SERVER_MAX_CLIENTS clients is accepted and written to.
+ *
+ *  Host test, see extras/host/README.md.
+ *
+ *  Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ *  SPDX-License-Identifier: LGPL-2.1
+ */
+
+#include <DA16200_WiFi.h>
+#include <DA16200Simulator.h>
+
+WiFiServer server(80);
+IPAddress peer(192, 168, 1, 50);
+uint8_t data[3000];
+
+void check(const char* name, bool ok) {
+  Serial.print(ok ? "PASS " : "FAIL ");
+  Serial.println(name);
+}
+
+void settle() {
+  for (unsigned long start = millis(); (millis() - start) < 500;) {
+    WiFi.loop();
+  }
+}
+
+int readAll(WiFiClient& client) {
+  int count = 0;
+
+  while (client.read() != -1) {
+    count++;
+  }
+
+  return count;
+}
+
+void setup() {
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = 'a' + (i % 26);
+  }
+
+  check("begin", WiFi.begin("DA16200-Sim", "password") == WL_CONNECTED);
+  server.begin();
+
+  // a single client has the whole server buffer
+  DA16200Sim.peerConnect(peer, 1000);
+  settle();
+
+  DA16200Sim.peerSend(peer, 1000, data, 1024);
+  settle();
+  WiFiClient client = server.available();
+  check("1024 byte frame to a single client", client && readAll(client) == 1024);
+
+  DA16200Sim.peerSend(peer, 1000, data, 3000);
+  settle();
+  client = server.available();
+  check("3000 byte frame to a single client", client && readAll(client) == 3000 && client.droppedBytes() == 0);
+
+  // two clients share it
+  DA16200Sim.peerConnect(peer, 1001);
+  settle();
+  DA16200Sim.peerSend(peer, 1000, data, 1400);
+  DA16200Sim.peerSend(peer, 1001, data, 1400);
+  settle();
+
+  int total = 0;
+
+  for (int i = 0; i < 2; i++) {
+    client = server.available();
+
+    if (client) {
+      total += readAll(client);
+    }
+  }
+
+  check("1400 byte frames to two clients", total == 2800);
+
+  // every client is accepted and written to
+  for (int i = 2; i < WIFI_SERVER_MAX_CLIENTS; i++) {
+    DA16200Sim.peerConnect(peer, 1000 + i);
+  }
+  settle();
+
+  int accepted = 0;
+
+  while (server.accept()) {
+    accepted++;
+  }
+
+  check("all clients accepted", accepted == WIFI_SERVER_MAX_CLIENTS);
+
+  unsigned long sends = DA16200Sim.sends(0);
+
+  server.write((const uint8_t*)"hello", 5);
+  check("write to all clients", (DA16200Sim.sends(0) - sends) == WIFI_SERVER_MAX_CLIENTS);
+}
+
+void loop() {
+}
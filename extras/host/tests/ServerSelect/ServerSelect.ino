@@ -0,0 +1,70 @@
+/*
+ *  WiFi.select() on a WiFiServer
+ *
+ *  Checks that a server served with available() is ready to read once when a client
+ *  connects, then only while a client has unread data, so select() waits out its timeout
+ *  in between.
+ *
+ *  Host test, see extras/host/README.md.
+ *
+ *  Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ *  SPDX-License-Identifier: LGPL-2.1
+ */
+
+#include <DA16200_WiFi.h>
+#include <DA16200Simulator.h>
+
+WiFiServer server(80);
+IPAddress peer(192, 168, 1, 50);
+
+void check(const char* name, bool ok) {
+  Serial.print(ok ? "PASS " : "FAIL ");
+  Serial.println(name);
+}
+
+int selectRead(unsigned long timeout, unsigned long* elapsed) {
+  wl_select_t entry;
+
+  memset(&entry, 0x00, sizeof(entry));
+  entry.server = &server;
+  entry.events = WL_SELECT_READ;
+
+  unsigned long start = millis();
+  int ready = WiFi.select(&entry, 1, timeout);
+
+  *elapsed = millis() - start;
+
+  return ready;
+}
+
+void setup() {
+  unsigned long elapsed;
+
+  check("begin", WiFi.begin("DA16200-Sim", "password") == WL_CONNECTED);
+  server.begin();
+
+  DA16200Sim.peerConnect(peer, 1000);
+  check("ready when a client connects", selectRead(500, &elapsed) == 1);
+  check("not ready again for the same client", selectRead(200, &elapsed) == 0 && elapsed >= 200);
+
+  DA16200Sim.peerSend(peer, 1000, (const uint8_t*)"hello", 5);
+  check("ready when the client sends", selectRead(500, &elapsed) == 1);
+
+  WiFiClient client = server.available();
+
+  int count = 0;
+
+  // the rest of the frame is still on its way
+  for (unsigned long start = millis(); (millis() - start) < 100;) {
+    if (client.read() != -1) {
+      count++;
+    }
+  }
+
+  check("client reads the data", count == 5);
+  check("not ready once the data is read", selectRead(200, &elapsed) == 0 && elapsed >= 200);
+}
+
+void loop() {
+}
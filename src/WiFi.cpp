@@ -8,12 +8,37 @@
 #include <string.h>
 #include <time.h>
 
+#include "WiFiClient.h"
 #include "WiFiServer.h"
+#include "WiFiUdp.h"
 
 #include "WiFi.h"
 
 #define WIFI_DEFAULT_TIMEOUT (30 * 1000) // 30 seconds
 
+// the command sequence and payload of a pipelined ESC(...) with several args
+struct WiFiPipelinedESC {
+  const char* sequence;
+  const char* const* args;
+  const wl_iovec_t* iov;
+  int iovcnt;
+  size_t offset;
+  size_t length;
+};
+
+// send one of the commands of a pipeline, returns the ticket or 0
+static int sendATPipelined(void* context, WiFiModem& modem, int index, int timeout)
+{
+  return modem.sendAT(((const char* const*)context)[index], NULL, timeout);
+}
+
+static int sendESCPipelined(void* context, WiFiModem& modem, int index, int timeout)
+{
+  WiFiPipelinedESC* esc = (WiFiPipelinedESC*)context;
+
+  return modem.sendESC(esc->sequence, esc->args[index], esc->iov, esc->iovcnt, esc->offset, esc->length, timeout);
+}
+
 WiFiClass::WiFiClass(HardwareSerial& serial, int rtcWakePin, int wakeUpPin) :
   _modem(serial, rtcWakePin, wakeUpPin),
   _irq(0),
@@ -21,10 +46,30 @@ WiFiClass::WiFiClass(HardwareSerial& serial, int rtcWakePin, int wakeUpPin) :
   _interface(0),
   _numConnectedSta(0),
   _lowPowerMode(0),
-  _timeout(WIFI_DEFAULT_TIMEOUT)
+  _timeout(WIFI_DEFAULT_TIMEOUT),
+  _baudRate(WIFI_SERIAL_BAUDRATE),
+  _flowControl(0),
+  _awake(0),
+  _sleepDelay(0),
+  _sleepPending(0),
+  _idleStart(0),
+  _keepAwake(0),
+  _wakeupCount(0),
+  _sleepCount(0)
 {
   _extendedResponse.reserve(64);
-  _scanCache.networkItem = 255;
+  memset(&_link, 0x00, sizeof(_link));
+  _scan.options = WL_SCAN_SORT_RSSI;
+  _scan.channels = 0;
+  _scan.result = 0;
+  _scan.notify = 0;
+  _scan.count = 0;
+
+  memset(&_callbacks, 0x00, sizeof(_callbacks));
+
+  for (int i = 0; i < WIFI_HOST_LOOKUP_MAX; i++) {
+    _hostLookups[i].state = LOOKUP_FREE;
+  }
 }
 
 WiFiClass::~WiFiClass()
@@ -39,16 +84,12 @@ uint8_t WiFiClass::status()
     return _status;
   }
 
-  if (_interface == 0) {
-    if (this->AT("+WFSTAT") == 0) {
-      if (_extendedResponse.indexOf("bssid=") != -1) {
-        _status = WL_CONNECTED;
-      } else {
-        _status = WL_DISCONNECTED;
-      }
-    }
-  } else {
-    _modem.poll(0);
+  // kept current by the connection events, the module is only asked when the state is unknown
+  _modem.poll(0);
+  processWrites();
+
+  if (_interface == 0 && (!_link.known || refreshDue())) {
+    refreshLink();
   }
 
   return _status;
@@ -183,29 +224,31 @@ int WiFiClass::begin(const char* ssid, uint8_t key_idx, const char* key, uint8_t
   }
 
   if ((uint32_t)_config.localIp != 0) {
-    this->AT("+NWDHC", "=0");
-  } else {
-    this->AT("+NWDHC", "=1");
-  }
-
-  if ((uint32_t)_config.localIp != 0) {
-    char args[1 + 1 + 1 + 15 + 1 + 15 + 1 + 15 + 1];
+    char nwip[5 + 1 + 1 + 1 + 15 + 1 + 15 + 1 + 15 + 1];
 
     sprintf(
-      args, "=%d,%d.%d.%d.%d,%d.%d.%d.%d,%d.%d.%d.%d",
+      nwip, "+NWIP=%d,%d.%d.%d.%d,%d.%d.%d.%d,%d.%d.%d.%d",
       _interface,
       _config.localIp[0], _config.localIp[1], _config.localIp[2], _config.localIp[3],
       _config.subnet[0], _config.subnet[1], _config.subnet[2], _config.subnet[3],
       _config.gateway[0], _config.gateway[1], _config.gateway[2], _config.gateway[3]
     );
-    
-    this->AT("+NWIP", args);
+
+    const char* const ipCommands[] = { "+NWDHC=0", nwip };
+
+    this->AT(ipCommands, 2);
+  } else {
+    this->AT("+NWDHC", "=1");
   }
 
   if (_status != WL_CONNECTED) {
     _status = WL_CONNECT_FAILED;
   }
 
+  // from here on the status follows the connection events
+  _link.known = 1;
+  _link.info = 0;
+
   return _status;
 }
 
@@ -247,38 +290,39 @@ uint8_t WiFiClass::beginAP(const char *ssid, const char* key, uint8_t channel)
     sprintf(args, "='%s',4,2,'%s'", ssid, key);
   }
 
-  if (this->AT("+WFSAP", args, 5000)) {
-    _status = WL_AP_FAILED;
-    return _status;
-  }
+  char wfsap[6 + sizeof(args)];
+  char wfapch[7 + 1 + 3 + 1];
+  char nwip[5 + 1 + 1 + 1 + 15 + 1 + 15 + 1 + 15 + 1];
+  const char* commands[4];
+  int count = 0;
 
-  sprintf(args, "=%d", channel);
-  if (this->AT("+WFAPCH", args)) {
-    _status = WL_AP_FAILED;
-    return _status;
-  }
+  sprintf(wfsap, "+WFSAP%s", args);
+  commands[count++] = wfsap;
 
-  if ((uint32_t)_config.localIp != 0) {
-    char args[1 + 1 + 1 + 15 + 1 + 15 + 1 + 15 + 1];
+  sprintf(wfapch, "+WFAPCH=%d", channel);
+  commands[count++] = wfapch;
 
+  if ((uint32_t)_config.localIp != 0) {
     sprintf(
-      args, "=%d,%d.%d.%d.%d,%d.%d.%d.%d,%d.%d.%d.%d",
+      nwip, "+NWIP=%d,%d.%d.%d.%d,%d.%d.%d.%d,%d.%d.%d.%d",
       _interface,
       _config.localIp[0], _config.localIp[1], _config.localIp[2], _config.localIp[3],
       _config.subnet[0], _config.subnet[1], _config.subnet[2], _config.subnet[3],
       _config.gateway[0], _config.gateway[1], _config.gateway[2], _config.gateway[3]
     );
-    
-    this->AT("+NWIP", args);
+    commands[count++] = nwip;
   }
 
-  if (this->AT("+NWDHS", "=1", 5000)) {
+  commands[count++] = "+NWDHS=1";
+
+  if (this->AT(commands, count, 5000)) {
     _status = WL_AP_FAILED;
     return _status;
   }
 
   _status = WL_AP_LISTENING;
   _numConnectedSta = 0;
+  _link.info = 0;
 
   return _status;
 }
@@ -292,6 +336,8 @@ void WiFiClass::disconnect()
   }
 
   _status = WL_DISCONNECTED;
+  _link.known = 1;
+  _link.info = 0;
 }
 
 void WiFiClass::config(IPAddress local_ip)
@@ -331,6 +377,8 @@ void WiFiClass::setDNS(IPAddress dns_server1)
   sprintf(args, "=%d.%d.%d.%d", dns_server1[0], dns_server1[1], dns_server1[2], dns_server1[3]);
 
   this->AT("+NWDNS", args);
+
+  _hostCache.clear();
 }
 
 IPAddress WiFiClass::localIP()
@@ -362,13 +410,11 @@ IPAddress WiFiClass::gatewayIP()
 
 const char* WiFiClass::SSID()
 {
-  _ssid[0] = '\0';
+  _modem.poll(0);
+  processWrites();
 
-  if (this->AT("+WFSTAT") == 0 && _extendedResponse.startsWith("+WFSTAT:")) {
-    int ssidIndex = _extendedResponse.indexOf("\nssid=");
-    if (ssidIndex != -1) {
-      sscanf(_extendedResponse.c_str() + ssidIndex + 1, "ssid=%32[^\n]\n", _ssid);
-    }
+  if (!_link.info || refreshDue()) {
+    refreshLink();
   }
 
   return _ssid;
@@ -376,23 +422,14 @@ const char* WiFiClass::SSID()
 
 uint8_t* WiFiClass::BSSID(uint8_t* bssid)
 {
-  memset(bssid, 0x00, 6);
-
-  int tmpBssid[6] = { 0, 0, 0, 0, 0, 0 };
+  _modem.poll(0);
+  processWrites();
 
-  if (this->AT("+WFSTAT") == 0 && _extendedResponse.startsWith("+WFSTAT:")) {
-    int bssidIndex = _extendedResponse.indexOf("\nbssid=");
-    if (bssidIndex != -1) {
-      sscanf(
-        _extendedResponse.c_str() + bssidIndex + 1, "bssid=%x:%x:%x:%x:%x:%x\n",
-        &tmpBssid[5], &tmpBssid[4], &tmpBssid[3], &tmpBssid[2], &tmpBssid[1], &tmpBssid[0]
-      );
-    }
+  if (!_link.info || refreshDue()) {
+    refreshLink();
   }
 
-  for (int i = 0; i < 6; i++) {
-    bssid[i] = tmpBssid[i];
-  }
+  memcpy(bssid, _link.bssid, 6);
 
   return bssid;
 }
@@ -410,134 +447,214 @@ int32_t WiFiClass::RSSI()
 
 uint8_t WiFiClass::encryptionType()
 {
-  uint8_t encType = ENC_TYPE_UNKNOWN;
-
-  if (this->AT("+WFSTAT") == 0 && _extendedResponse.startsWith("+WFSTAT:")) {
-    if (_extendedResponse.indexOf("key_mgmt=WPA2-AUTO") != -1) { // TODO: verify
-      encType = ENC_TYPE_AUTO;
-    } else if (_extendedResponse.indexOf("key_mgmt=WPA2-PSK") != -1) {
-      encType = ENC_TYPE_CCMP;
-    } else if (_extendedResponse.indexOf("key_mgmt=WPA-PSK") != -1) {
-      encType = ENC_TYPE_TKIP;
-    } else if (_extendedResponse.indexOf("group_cipher=WEP") != -1) {
-      encType = ENC_TYPE_WEP;
-    } else if (_extendedResponse.indexOf("key_mgmt=NONE") != -1) {
-      encType = ENC_TYPE_NONE;
-    }
+  _modem.poll(0);
+  processWrites();
 
-    if (_interface == 1 && encType == ENC_TYPE_UNKNOWN) {
-      encType = ENC_TYPE_NONE;
-    }
+  if (!_link.info || refreshDue()) {
+    refreshLink();
   }
 
-  return encType;
+  return _link.encryptionType;
+}
+
+void WiFiClass::setStatusRefresh(unsigned long interval)
+{
+  _link.refreshInterval = interval;
 }
 
 int8_t WiFiClass::scanNetworks()
 {
-  _scanExtendedResponse = "";
-  _scanCache.networkItem = 255;
+  return scanNetworks(NULL);
+}
+
+int8_t WiFiClass::scanNetworks(const char* ssid)
+{
+  if (!beginScanNetworks(ssid)) {
+    return -1;
+  }
+
+  int8_t result;
+
+  while ((result = scanComplete()) == WL_SCAN_RUNNING);
+
+  // the result has been returned, no need for the callback
+  _scan.notify = 0;
+
+  return (result == WL_SCAN_FAILED) ? -1 : result;
+}
+
+int WiFiClass::beginScanNetworks()
+{
+  return beginScanNetworks(NULL);
+}
+
+int WiFiClass::beginScanNetworks(const char* ssid)
+{
+  if (_scan.result == WL_SCAN_RUNNING) {
+    return 0;
+  }
 
   if (_status == WL_NO_SHIELD) {
     if (!init()) {
-      return -1;
+      return 0;
     }
   }
 
-  if (this->AT("+WFSCAN", NULL, 5000) != 0 || !_extendedResponse.startsWith("+WFSCAN:")) {
-    _status = WL_NO_SSID_AVAIL;
-    return -1;
+  _scan.ssid[0] = '\0';
+  if (ssid != NULL) {
+    strncat(_scan.ssid, ssid, sizeof(_scan.ssid) - 1);
+  }
+
+  _scan.count = 0;
+  _scan.ticket = 0;
+  _scan.received = 0;
+  _scan.notify = 0;
+  _scan.result = WL_SCAN_RUNNING;
+
+  processScan();
+
+  return 1;
+}
+
+int8_t WiFiClass::scanComplete()
+{
+  if (_scan.result == WL_SCAN_RUNNING) {
+    poll(0);
+  }
+
+  return _scan.result;
+}
+
+void WiFiClass::processScan()
+{
+  if (_scan.result != WL_SCAN_RUNNING) {
+    return;
   }
 
-  int numSsid = -1;
+  if (_scan.ticket == 0) {
+    // leave room for a blocking command
+    if (_modem.pending() >= WIFI_BACKGROUND_MAX_PENDING) {
+      return;
+    }
+
+    wakeup();
+
+    _scan.ticket = _modem.sendAT("+WFSCAN", NULL, 5000);
+    _scan.start = millis();
+
+    return;
+  }
 
-  _scanExtendedResponse = _extendedResponse.substring(8);
+  if (_scan.ticket > _modem.currentTicket()) {
+    // still behind other commands, its time starts once the module gets to it
+    _scan.start = millis();
+    return;
+  }
 
-  for (unsigned int i = 0; i < _scanExtendedResponse.length(); i++) {
-    if (_scanExtendedResponse[i] == '\n') {
-      numSsid++;
+  if (_scan.ticket == _modem.currentTicket()) {
+    if ((millis() - _scan.start) < 5000) {
+      return;
     }
+
+    // give up on it, like a blocking scan would
+    _modem.abandon(_scan.ticket);
   }
 
-  if (numSsid > 0) {
-    _status = WL_SCAN_COMPLETED;
+  // the networks were parsed from the +WFSCAN response by handleExtendedResponse(...)
+  if (_scan.received) {
+    _scan.result = _scan.count;
   } else {
-    _status = WL_NO_SSID_AVAIL;
+    _scan.result = WL_SCAN_FAILED;
   }
 
-  return numSsid;
+  _status = (_scan.count > 0) ? WL_SCAN_COMPLETED : WL_NO_SSID_AVAIL;
+  // the next status() reports the connection again
+  _link.known = 0;
+  _scan.notify = 1;
+
+  idle();
 }
 
 const char* WiFiClass::SSID(uint8_t networkItem)
 {
-  if (_scanCache.networkItem != networkItem) {
-    if (!parseScanNetworksItem(networkItem)) {
-      return "";
-    }
+  if (networkItem >= _scan.count) {
+    return "";
   }
 
-  return _scanCache.ssid;
+  return _scan.networks[networkItem].ssid;
 }
 
 uint8_t WiFiClass::encryptionType(uint8_t networkItem)
 {
-  if (_scanCache.networkItem != networkItem) {
-    if (!parseScanNetworksItem(networkItem)) {
-      return ENC_TYPE_UNKNOWN;
-    }
+  if (networkItem >= _scan.count) {
+    return ENC_TYPE_UNKNOWN;
   }
 
-  return _scanCache.encryptionType;
+  return _scan.networks[networkItem].encryptionType;
 }
 
 uint8_t* WiFiClass::BSSID(uint8_t networkItem, uint8_t* bssid)
 {
   memset(bssid, 0x00, 6);
 
-  if (_scanCache.networkItem != networkItem) {
-    if (!parseScanNetworksItem(networkItem)) {
-      return bssid;
-    }
+  if (networkItem >= _scan.count) {
+    return bssid;
   }
 
-  memcpy(bssid, _scanCache.bssid, 6);
+  memcpy(bssid, _scan.networks[networkItem].bssid, 6);
 
   return bssid;
 }
 
 uint8_t WiFiClass::channel(uint8_t networkItem)
 {
-  if (_scanCache.networkItem != networkItem) {
-    if (!parseScanNetworksItem(networkItem)) {
-      return 0;
-    }
+  if (networkItem >= _scan.count) {
+    return 0;
   }
 
-  return _scanCache.channel;
+  return _scan.networks[networkItem].channel;
 }
 
 int32_t WiFiClass::RSSI(uint8_t networkItem)
 {
-  if (_scanCache.networkItem != networkItem) {
-    if (!parseScanNetworksItem(networkItem)) {
-      return 0;
-    }
+  if (networkItem >= _scan.count) {
+    return 0;
   }
 
-  return _scanCache.rssi;
+  return _scan.networks[networkItem].rssi;
+}
+
+void WiFiClass::setScanOptions(uint8_t options)
+{
+  _scan.options = options;
+}
+
+void WiFiClass::setScanChannels(const uint8_t* channels, int count)
+{
+  _scan.channels = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (channels[i] > 0 && channels[i] <= 14) {
+      _scan.channels |= (1 << channels[i]);
+    }
+  }
 }
 
 void WiFiClass::end()
 {
   _modem.end();
   _socketBuffer.clear();
+  _hostCache.clear();
 
   _status = WL_NO_SHIELD;
   _numConnectedSta = 0;
+  _link.known = 0;
+  _link.info = 0;
 
   memset(_firmwareVersion, 0x00, sizeof(_firmwareVersion));
-  _scanCache.networkItem = 255;
-  _scanExtendedResponse = "";
+  _scan.result = 0;
+  _scan.notify = 0;
+  _scan.count = 0;
 
   _config.localIp = (uint32_t)0;
   _config.gateway = (uint32_t)0;
@@ -545,18 +662,39 @@ void WiFiClass::end()
 
   _lowPowerMode = 0;
   _timeout = WIFI_DEFAULT_TIMEOUT;
+  _awake = 0;
+  _sleepDelay = 0;
+  _sleepPending = 0;
+  _keepAwake = 0;
+
+  for (int i = 0; i < WIFI_HOST_LOOKUP_MAX; i++) {
+    _hostLookups[i].state = LOOKUP_FREE;
+  }
 }
 
 int WiFiClass::hostByName(const char* aHostname, IPAddress& aResult)
 {
   aResult = (uint32_t)0;
 
+  int cached = _hostCache.lookup(aHostname, aResult);
+
+  if (cached != 0) {
+    return (cached > 0) ? 1 : 0;
+  }
+
   char args[1 + strlen(aHostname) + 1];
 
   sprintf(args, "=%s", aHostname);
 
   for (int retry = 0; retry < 30; retry++) {
-    if (this->AT("+NWHOST", args, 10000) != 0 || !_extendedResponse.startsWith("+NWHOST:")) {
+    int result = this->AT("+NWHOST", args, 10000);
+
+    if (result != 0 || !_extendedResponse.startsWith("+NWHOST:")) {
+      // only remember hostnames the module reported as unresolvable
+      if (result != 0 && result != WIFI_MODEM_TIMEOUT) {
+        _hostCache.store(aHostname, aResult);
+      }
+
       return 0;
     }
 
@@ -576,6 +714,8 @@ int WiFiClass::hostByName(const char* aHostname, IPAddress& aResult)
     }
   }
 
+  _hostCache.store(aHostname, aResult);
+
   if ((uint32_t)aResult == 0) {
     return 0;
   }
@@ -583,6 +723,149 @@ int WiFiClass::hostByName(const char* aHostname, IPAddress& aResult)
   return 1;
 }
 
+int WiFiClass::prefetchHost(const char* hostname)
+{
+  IPAddress ip;
+
+  return hostByName(hostname, ip);
+}
+
+void WiFiClass::invalidateHost(const char* hostname)
+{
+  _hostCache.invalidate(hostname);
+}
+
+void WiFiClass::invalidateHosts()
+{
+  _hostCache.clear();
+}
+
+void WiFiClass::setHostCacheTTL(unsigned long ttl, unsigned long negativeTtl)
+{
+  _hostCache.setTTL(ttl, negativeTtl);
+}
+
+int WiFiClass::beginHostByName(const char* hostname)
+{
+  if (strlen(hostname) > WIFI_HOST_CACHE_NAME_SIZE) {
+    return 0;
+  }
+
+  for (int i = 0; i < WIFI_HOST_LOOKUP_MAX; i++) {
+    if (_hostLookups[i].state != LOOKUP_FREE) {
+      continue;
+    }
+
+    strcpy(_hostLookups[i].hostname, hostname);
+    _hostLookups[i].result = (uint32_t)0;
+    _hostLookups[i].retries = 0;
+    _hostLookups[i].resent = 0;
+    _hostLookups[i].start = millis();
+
+    if (_hostCache.lookup(hostname, _hostLookups[i].result) != 0) {
+      _hostLookups[i].state = LOOKUP_DONE;
+    } else {
+      _hostLookups[i].state = LOOKUP_QUEUED;
+
+      processHostLookups();
+    }
+
+    return i + 1;
+  }
+
+  return 0;
+}
+
+int WiFiClass::checkHostByName(int handle, IPAddress& result)
+{
+  if (handle < 1 || handle > WIFI_HOST_LOOKUP_MAX || _hostLookups[handle - 1].state == LOOKUP_FREE) {
+    return -1;
+  }
+
+  poll(0);
+
+  if (_hostLookups[handle - 1].state != LOOKUP_DONE) {
+    return 0;
+  }
+
+  _hostLookups[handle - 1].state = LOOKUP_FREE;
+  result = _hostLookups[handle - 1].result;
+
+  return ((uint32_t)result == 0) ? -1 : 1;
+}
+
+void WiFiClass::processHostLookups()
+{
+  for (int i = 0; i < WIFI_HOST_LOOKUP_MAX; i++) {
+    if (_hostLookups[i].state == LOOKUP_SENT) {
+      int ticket = _hostLookups[i].ticket;
+      int expired = 0;
+
+      if (ticket >= _modem.currentTicket()) {
+        if ((millis() - _hostLookups[i].start) >= 10000) {
+          // give up on it, like a blocking lookup would
+          _modem.abandon(ticket);
+          expired = 1;
+        } else {
+          continue;
+        }
+      }
+
+      // the address was picked up from the +NWHOST response by handleExtendedResponse(...)
+      int result = _modem.responseCode(ticket);
+
+      if ((uint32_t)_hostLookups[i].result != 0) {
+        _hostCache.store(_hostLookups[i].hostname, _hostLookups[i].result);
+        _hostLookups[i].state = LOOKUP_DONE;
+      } else if (result == 0 && ++_hostLookups[i].retries < 30) {
+        // the module has no address yet, ask again after a while
+        _hostLookups[i].state = LOOKUP_QUEUED;
+        _hostLookups[i].start = millis();
+      } else if (result == WIFI_MODEM_TIMEOUT && !expired && !_hostLookups[i].resent) {
+        // the response was lost, to a blocking command giving up on the commands before it or
+        // to newer commands recycling the ticket before this poll, ask once more
+        _hostLookups[i].resent = 1;
+        _hostLookups[i].state = LOOKUP_QUEUED;
+        _hostLookups[i].start = millis();
+      } else {
+        // a lookup that timed out is not remembered as unresolvable
+        if (result != WIFI_MODEM_TIMEOUT) {
+          _hostCache.store(_hostLookups[i].hostname, _hostLookups[i].result);
+        }
+
+        _hostLookups[i].state = LOOKUP_DONE;
+      }
+
+      idle();
+    }
+
+    if (_hostLookups[i].state == LOOKUP_QUEUED) {
+      if (_hostLookups[i].retries > 0 && (millis() - _hostLookups[i].start) < 500) {
+        continue;
+      }
+
+      // leave room for a blocking command
+      if (_modem.pending() >= WIFI_BACKGROUND_MAX_PENDING) {
+        continue;
+      }
+
+      char args[1 + WIFI_HOST_CACHE_NAME_SIZE + 1];
+
+      sprintf(args, "=%s", _hostLookups[i].hostname);
+
+      wakeup();
+
+      int ticket = _modem.sendAT("+NWHOST", args, 10000);
+
+      if (ticket != 0) {
+        _hostLookups[i].state = LOOKUP_SENT;
+        _hostLookups[i].ticket = ticket;
+        _hostLookups[i].start = millis();
+      }
+    }
+  }
+}
+
 int WiFiClass::ping(const char* hostname)
 {
   IPAddress host;
@@ -610,7 +893,7 @@ int WiFiClass::ping(IPAddress host)
   );
 
   int result = this->AT("+NWPING", args, 10000);
-  if (result == -100) {
+  if (result == WIFI_MODEM_TIMEOUT) {
     return WL_PING_TIMEOUT;
   } else if (result != 0 || !_extendedResponse.startsWith("+NWPING:")) {
     return WL_PING_ERROR;
@@ -670,137 +953,604 @@ void WiFiClass::lowPowerMode()
 void WiFiClass::noLowPowerMode()
 {
   _lowPowerMode = 0;
+  _sleepPending = 0;
 
   AT();
 }
 
-void WiFiClass::setTimeout(unsigned long timeout)
+void WiFiClass::setSleepDelay(unsigned long delay)
 {
-  _timeout = timeout;
+  _sleepDelay = delay;
 }
 
-void WiFiClass::debug(Print& p)
+void WiFiClass::beginKeepAwake()
 {
-  _modem.debug(p);
+  _keepAwake++;
 }
 
-void WiFiClass::noDebug()
+void WiFiClass::endKeepAwake()
 {
-  _modem.noDebug();
+  if (_keepAwake > 0) {
+    _keepAwake--;
+  }
+
+  checkSleep();
 }
 
-int WiFiClass::AT(const char* command, const char* args, int timeout)
+uint32_t WiFiClass::wakeupCount()
 {
-  wakeup();
-
-  int result = _modem.AT(command, args, timeout);
-
-  if (_lowPowerMode) {
-    _modem.AT("+SETDPMSLPEXT", NULL, 1000);
-  }
+  return _wakeupCount;
+}
 
-  return result;
+uint32_t WiFiClass::sleepCount()
+{
+  return _sleepCount;
 }
 
-int WiFiClass::ESC(const char* sequence, const char* args, const uint8_t* buffer, int length, int timeout)
+int WiFiClass::select(wl_select_t* sockets, int count, unsigned long timeout)
 {
-  wakeup();
+  unsigned long start = millis();
+  unsigned long wait = 0;
 
-  int result = _modem.ESC(sequence, args, buffer, length, timeout);
+  for (;;) {
+    poll(wait);
 
-  if (_lowPowerMode) {
-    _modem.AT("+SETDPMSLPEXT", NULL, 1000);
-  }
+    int ready = 0;
 
-  return result;
-}
+    for (int i = 0; i < count; i++) {
+      uint8_t revents = 0;
 
-void WiFiClass::poll(unsigned long timeout)
-{
-  int sleep = 0;
+      if (sockets[i].client != NULL) {
+        revents = sockets[i].client->ready();
+      } else if (sockets[i].server != NULL) {
+        revents = sockets[i].server->ready();
+      } else if (sockets[i].udp != NULL) {
+        revents = sockets[i].udp->ready();
+      }
 
-  if (_irq) {
-    sleep = 1;
-    _irq = 0;
-    wakeup();
-  }
+      sockets[i].revents = revents & sockets[i].events;
 
-  _modem.poll(timeout);
+      if (sockets[i].revents) {
+        ready++;
+      }
+    }
+
+    unsigned long elapsed = millis() - start;
+
+    if (ready || elapsed >= timeout) {
+      return ready;
+    }
 
-  if (_lowPowerMode && sleep) {
-    _modem.AT("+SETDPMSLPEXT", NULL, 1000);
+    wait = timeout - elapsed;
   }
 }
 
-void WiFiClass::wakeup()
+void WiFiClass::onData(wl_client_callback_t callback)
 {
-  _run = 0;
-  _modem.wakeup();
+  _callbacks.data = callback;
+}
 
-  // TODO: remove wake timeout, seems only needed for case after WiFi.noLowPowerMode() is called
-  for (unsigned long start = millis(); (millis() - start) < 100;) {
-    _modem.poll(0);
+void WiFiClass::onData(wl_udp_callback_t callback)
+{
+  _callbacks.packet = callback;
+}
 
-    if (_run != 0) {
-      break;
-    }
-  }
+void WiFiClass::onAccept(wl_client_callback_t callback)
+{
+  _callbacks.accept = callback;
+}
 
-  _irq = 0;
+void WiFiClass::onClose(wl_client_callback_t callback)
+{
+  _callbacks.close = callback;
+}
 
-  _modem.AT("+MCUWUDONE", NULL, 1000);
-  _modem.AT("+CLRDPMSLPEXT", NULL, 1000);
+void WiFiClass::onLinkDown(wl_callback_t callback)
+{
+  _callbacks.linkDown = callback;
 }
 
-WiFiSocketBuffer& WiFiClass::socketBuffer()
+void WiFiClass::onHostByName(wl_host_callback_t callback)
 {
-  return _socketBuffer;
+  _callbacks.host = callback;
 }
 
-int WiFiClass::init()
+void WiFiClass::onScanNetworks(wl_scan_callback_t callback)
 {
-  _status = WL_NO_SHIELD;
+  _callbacks.scan = callback;
+}
 
-  _modem.begin(115200);
-  _modem.onExtendedResponse(WiFiClass::onExtendedResponseHandler, this);
-  _modem.onIrq(WiFiClass::onIrq);
+void WiFiClass::loop()
+{
+  poll(0);
 
-  _modem.wakeup();
-  delay(150);
+  if (_callbacks.linkDownPending) {
+    _callbacks.linkDownPending = 0;
 
-  this->AT("+MCUWUDONE");
-  this->AT("+CLRDPMSLPEXT");
+    if (_callbacks.linkDown != NULL) {
+      _callbacks.linkDown();
+    }
+  }
 
-  if (this->AT("Z") != 0) {
-    end();
+  if (_callbacks.host != NULL) {
+    for (int i = 0; i < WIFI_HOST_LOOKUP_MAX; i++) {
+      if (_hostLookups[i].state == LOOKUP_DONE) {
+        _callbacks.host(i + 1, _hostLookups[i].hostname, _hostLookups[i].result);
 
+        _hostLookups[i].state = LOOKUP_FREE;
+      }
+    }
+  }
+
+  if (_scan.notify) {
+    _scan.notify = 0;
+
+    if (_callbacks.scan != NULL) {
+      _callbacks.scan(_scan.result);
+    }
+  }
+
+  if (_callbacks.accept != NULL) {
+    for (int socket; (socket = _socketBuffer.acceptPeer()) > -1;) {
+      WiFiClient client(0, _socketBuffer.remoteIP(socket), _socketBuffer.remotePort(socket));
+
+      _callbacks.accept(client);
+    }
+  }
+
+  if (_callbacks.data != NULL) {
+    if (WiFiClient::_inst != NULL && _socketBuffer.available(1)) {
+      _callbacks.data(*WiFiClient::_inst);
+    }
+
+    for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+      if (_socketBuffer.available(i)) {
+        WiFiClient client(0, _socketBuffer.remoteIP(i), _socketBuffer.remotePort(i));
+
+        _callbacks.data(client);
+      }
+    }
+  }
+
+  if (_callbacks.packet != NULL && WiFiUDP::_inst != NULL &&
+      (_socketBuffer.available(2) || _socketBuffer.packets(2))) {
+    _callbacks.packet(*WiFiUDP::_inst);
+  }
+
+  for (int socket; (socket = _socketBuffer.nextClosed()) > -1;) {
+    if (_callbacks.close == NULL) {
+      continue;
+    }
+
+    if (socket == 1) {
+      if (WiFiClient::_inst != NULL) {
+        _callbacks.close(*WiFiClient::_inst);
+      }
+    } else {
+      WiFiClient client(0, _socketBuffer.remoteIP(socket), _socketBuffer.remotePort(socket));
+
+      _callbacks.close(client);
+    }
+  }
+}
+
+void WiFiClass::drainSerial()
+{
+  _modem.drain();
+}
+
+size_t WiFiClass::rxHighWater()
+{
+  return _modem.rxHighWater();
+}
+
+uint32_t WiFiClass::rxFull()
+{
+  return _modem.rxFull();
+}
+
+int WiFiClass::setBaudRate(unsigned long baudrate)
+{
+  if (baudrate == _baudRate) {
+    return 1;
+  }
+
+  char args[1 + 10 + 8 + 1];
+
+  sprintf(args, "=%lu%s", baudrate, _flowControl ? ",8,n,1,h" : "");
+
+  if (this->AT("B", args) != 0) {
     return 0;
   }
 
+  unsigned long previous = _baudRate;
 
-  if (this->AT("+WFDIS", "=1") != 0) {
-    end();
+  _modem.setBaudRate(baudrate);
+
+  for (int retry = 0; retry < 3; retry++) {
+    if (this->AT("", NULL, 500) == 0) {
+      _baudRate = baudrate;
 
+      return 1;
+    }
+  }
+
+  // fall back, ask the module to return to the previous rate in case it did switch
+  sprintf(args, "=%lu%s", previous, _flowControl ? ",8,n,1,h" : "");
+
+  this->AT("B", args, 500);
+
+  _modem.setBaudRate(previous);
+  this->AT("", NULL, 500);
+
+  return 0;
+}
+
+int WiFiClass::flowControl(int rtsPin, int ctsPin)
+{
+  char args[1 + 10 + 8 + 1];
+
+  sprintf(args, "=%lu,8,n,1,h", _baudRate);
+
+  if (this->AT("B", args) != 0) {
     return 0;
   }
 
-  if (this->AT("+TRTALL", NULL, 5000) != 0) {
-    end();
+  _modem.flowControl(rtsPin, ctsPin);
+
+  if (this->AT("", NULL, 500) != 0) {
+    noFlowControl();
 
     return 0;
   }
 
-  if (this->AT("+NWSNTP", "=1") != 0) {
+  _flowControl = 1;
+
+  return 1;
+}
+
+void WiFiClass::noFlowControl()
+{
+  char args[1 + 10 + 8 + 1];
+
+  sprintf(args, "=%lu,8,n,1,n", _baudRate);
+
+  _modem.noFlowControl();
+  _flowControl = 0;
+
+  this->AT("B", args, 500);
+}
+
+unsigned long WiFiClass::baudRate()
+{
+  return _baudRate;
+}
+
+void WiFiClass::setTimeout(unsigned long timeout)
+{
+  _timeout = timeout;
+}
+
+void WiFiClass::setBufferPool(uint8_t* buffer, size_t size)
+{
+  _socketBuffer.setPool(buffer, size);
+}
+
+void WiFiClass::debug(Print& p)
+{
+  _modem.debug(p);
+}
+
+void WiFiClass::noDebug()
+{
+  _modem.noDebug();
+}
+
+int WiFiClass::AT(const char* command, const char* args, int timeout)
+{
+  wakeup();
+
+  int result = _modem.AT(command, args, timeout);
+
+  idle();
+
+  return result;
+}
+
+int WiFiClass::AT(const char* const commands[], int count, int timeout)
+{
+  // stop at the first error and return it
+  int result = 0;
+
+  pipeline(count, timeout, sendATPipelined, (void*)commands, 1, &result);
+
+  return result;
+}
+
+int WiFiClass::ESC(const char* sequence, const char* args, const uint8_t* buffer, int length, int timeout)
+{
+  wakeup();
+
+  int result = _modem.ESC(sequence, args, buffer, length, timeout);
+
+  idle();
+
+  return result;
+}
+
+int WiFiClass::ESC(const char* sequence, const char* args, const wl_iovec_t* iov, int iovcnt, size_t offset, size_t length, int timeout)
+{
+  wakeup();
+
+  int result = _modem.ESC(sequence, args, iov, iovcnt, offset, length, timeout);
+
+  idle();
+
+  return result;
+}
+
+int WiFiClass::ESC(const char* sequence, const char* const args[], int count, const wl_iovec_t* iov, int iovcnt, size_t offset, size_t length, int timeout)
+{
+  // the same payload with each of the args, return the number of successful sends
+  WiFiPipelinedESC esc = { sequence, args, iov, iovcnt, offset, length };
+  int result = 0;
+
+  return pipeline(count, timeout, sendESCPipelined, &esc, 0, &result);
+}
+
+int WiFiClass::pipeline(int count, int timeout, int (*send)(void*, WiFiModem&, int, int), void* context, int stopOnError, int* result)
+{
+  // keep up to WIFI_MODEM_MAX_PENDING commands in flight
+  int succeeded = 0;
+  int tickets[WIFI_MODEM_MAX_PENDING];
+  int sent = 0;
+  int completed = 0;
+
+  wakeup();
+
+  while (completed < count) {
+    if ((*result == 0 || !stopOnError) && sent < count && (sent - completed) < WIFI_MODEM_MAX_PENDING) {
+      int ticket = send(context, _modem, sent, timeout);
+
+      if (ticket != 0) {
+        tickets[sent % WIFI_MODEM_MAX_PENDING] = ticket;
+        sent++;
+        continue;
+      }
+
+      if (completed == sent && _modem.pending() >= WIFI_MODEM_MAX_PENDING && _modem.beginCommand(timeout)) {
+        // the queue was full of other commands, and has room now
+        continue;
+      }
+    }
+
+    if (completed == sent) {
+      if (*result == 0) {
+        *result = WIFI_MODEM_TIMEOUT;
+      }
+      break;
+    }
+
+    int responseCode = _modem.waitForResponse(tickets[completed % WIFI_MODEM_MAX_PENDING], timeout);
+
+    if (responseCode == 0) {
+      succeeded++;
+    } else if (*result == 0) {
+      *result = responseCode;
+    }
+
+    completed++;
+  }
+
+  idle();
+
+  return succeeded;
+}
+
+size_t WiFiClass::send(int cid, IPAddress ip, uint16_t port, const wl_iovec_t* iov, int iovcnt)
+{
+  size_t total = 0;
+
+  for (int i = 0; i < iovcnt; i++) {
+    total += iov[i].size;
+  }
+
+  size_t sent = 0;
+
+  while (sent < total) {
+    size_t size = total - sent;
+
+    if (size > WIFI_MODEM_MAX_SEND_SIZE) {
+      size = WIFI_MODEM_MAX_SEND_SIZE;
+    }
+
+    char args[1 + 4 + 1 + 15 + 1 + 5 + 1 + 1];
+
+    sprintf(
+      args, "%d%d,%d.%d.%d.%d,%d,",
+      cid, (int)size,
+      ip[0], ip[1], ip[2], ip[3],
+      port
+    );
+
+    if (ESC("S", args, iov, iovcnt, sent, size) != 0) {
+      break;
+    }
+
+    sent += size;
+  }
+
+  return sent;
+}
+
+int WiFiClass::flush(int cid)
+{
+  size_t length = _socketBuffer.txAvailable(cid);
+
+  if (length == 0) {
+    return 1;
+  }
+
+  wl_iovec_t iov = { _socketBuffer.txBuffer(cid), length };
+
+  IPAddress ip = _socketBuffer.txRemoteIP(cid);
+  uint16_t port = _socketBuffer.txRemotePort(cid);
+  size_t sent = send(cid, ip, port, &iov, 1);
+
+  if (sent < length) {
+    int socket = (cid == 0) ? _socketBuffer.peer(ip, port) : cid;
+
+    if (socket > -1 && _socketBuffer.connected(socket)) {
+      // keep what was not sent for the next flush
+      _socketBuffer.txConsume(cid, sent);
+
+      return 0;
+    }
+  }
+
+  _socketBuffer.txClear(cid);
+
+  return (sent == length);
+}
+
+void WiFiClass::processWrites()
+{
+  // send held back writes once their delay has passed
+  for (int cid = 0; cid < 2; cid++) {
+    if (_socketBuffer.txDue(cid)) {
+      flush(cid);
+    }
+  }
+}
+
+void WiFiClass::poll(unsigned long timeout)
+{
+  int irq = 0;
+
+  if (_irq) {
+    irq = 1;
+    _irq = 0;
+    wakeup();
+  }
+
+  _modem.poll(timeout);
+
+  processHostLookups();
+  processScan();
+  processWrites();
+
+  if (irq) {
+    idle();
+  }
+
+  checkSleep();
+}
+
+void WiFiClass::wakeup()
+{
+  if (_awake) {
+    // the module was not allowed to sleep since the last handshake
+    _irq = 0;
+    return;
+  }
+
+  _run = 0;
+  _modem.wakeup();
+
+  // TODO: remove wake timeout, seems only needed for case after WiFi.noLowPowerMode() is called
+  for (unsigned long start = millis(); (millis() - start) < 100;) {
+    _modem.poll(0);
+
+    if (_run != 0) {
+      break;
+    }
+  }
+
+  _irq = 0;
+
+  // responses arrive in order, so waiting for the last command covers both
+  _modem.sendAT("+MCUWUDONE", NULL, 0);
+  if (_modem.waitForResponse(_modem.sendAT("+CLRDPMSLPEXT", NULL, 1000), 1000) == 0) {
+    _awake = 1;
+  }
+
+  _wakeupCount++;
+}
+
+void WiFiClass::idle()
+{
+  if (!_lowPowerMode) {
+    return;
+  }
+
+  _sleepPending = 1;
+  _idleStart = millis();
+
+  checkSleep();
+}
+
+void WiFiClass::checkSleep()
+{
+  // commands still waiting for a response, such as outstanding lookups, keep the module awake
+  if (_sleepPending && _keepAwake == 0 && _modem.pending() == 0 && (millis() - _idleStart) >= _sleepDelay) {
+    sleep();
+  }
+}
+
+void WiFiClass::sleep()
+{
+  // the module may enter DPM sleep from here on, so the next command needs a wakeup
+  _awake = 0;
+  _sleepPending = 0;
+  _sleepCount++;
+
+  _modem.AT("+SETDPMSLPEXT", NULL, 1000);
+}
+
+WiFiSocketBuffer& WiFiClass::socketBuffer()
+{
+  return _socketBuffer;
+}
+
+int WiFiClass::init()
+{
+  _status = WL_NO_SHIELD;
+
+  _baudRate = WIFI_SERIAL_BAUDRATE;
+  _flowControl = 0;
+  _modem.begin(_baudRate);
+  _modem.onExtendedResponse(WiFiClass::onExtendedResponseHandler, this);
+  _modem.streamExtendedResponse("+WFSCAN:");
+  _modem.onReceive(WiFiClass::onReceiveHandler, this);
+  _modem.onIrq(WiFiClass::onIrq);
+
+  _modem.wakeup();
+  delay(150);
+
+  // the module state is unknown, always start with the full handshake
+  _awake = 0;
+  wakeup();
+
+  if (!_awake && probeBaudRate()) {
+    wakeup();
+  }
+
+  const char* const initCommands[] = { "Z", "+WFDIS=1", "+TRTALL", "+NWSNTP=1" };
+
+  if (this->AT(initCommands, 4, 5000) != 0) {
     end();
 
     return 0;
   }
 
   _status = WL_IDLE_STATUS;
+  _link.known = 0;
+  _link.info = 0;
 
   memset(_firmwareVersion, 0x00, sizeof(_firmwareVersion));
-  _scanCache.networkItem = 255;
-  _scanExtendedResponse = "";
+  _scan.result = 0;
+  _scan.notify = 0;
+  _scan.count = 0;
   _irq = 0;
 
   if (this->AT("+DPM", "=1") != 0) {
@@ -816,12 +1566,55 @@ int WiFiClass::init()
     }
   }
 
-  this->AT("+WFQAP");
-  this->AT("+WFTAP");
+  const char* const disconnectCommands[] = { "+WFQAP", "+WFTAP" };
+
+  this->AT(disconnectCommands, 2);
+
+#if defined(WIFI_SERIAL_RTS_PIN) && defined(WIFI_SERIAL_CTS_PIN)
+  flowControl(WIFI_SERIAL_RTS_PIN, WIFI_SERIAL_CTS_PIN);
+#endif
+
+#ifdef WIFI_SERIAL_NEGOTIATE_BAUDRATE
+  setBaudRate(WIFI_SERIAL_NEGOTIATE_BAUDRATE);
+#endif
 
   return 1;
 }
 
+int WiFiClass::probeBaudRate()
+{
+  // the module may still be at a rate set before the board was reset
+  static const unsigned long baudRates[] = { 921600, 460800, 230400, 115200 };
+  const size_t count = sizeof(baudRates) / sizeof(baudRates[0]);
+
+  // the list, followed by WIFI_SERIAL_BAUDRATE unless it is already in the list
+  for (size_t i = 0; i <= count; i++) {
+    unsigned long baudRate = (i < count) ? baudRates[i] : WIFI_SERIAL_BAUDRATE;
+
+    if (i == count) {
+      size_t j;
+
+      for (j = 0; j < count && baudRates[j] != baudRate; j++);
+
+      if (j < count) {
+        break;
+      }
+    }
+
+    _modem.setBaudRate(baudRate);
+
+    if (_modem.AT("", NULL, 100) == 0) {
+      _baudRate = baudRate;
+
+      return 1;
+    }
+  }
+
+  _modem.setBaudRate(_baudRate);
+
+  return 0;
+}
+
 int WiFiClass::setMode(int mode)
 {
   char args[3];
@@ -854,52 +1647,42 @@ int WiFiClass::setMode(int mode)
   return 0;
 }
 
-int WiFiClass::parseScanNetworksItem(uint8_t networkItem)
+void WiFiClass::parseScanNetworks(const char* line)
 {
-  unsigned int index;
-  int startIndex = 0;
-  int endIndex = 0;
-  int newLineCount = 0;
-
-  for (index = 0; index < _scanExtendedResponse.length(); index++) {
-    if (_scanExtendedResponse[index] == '\n') {
-      newLineCount++;
+  // one network per line, the table was emptied when the scan started
+  parseScanNetwork(line);
 
-      if (networkItem == newLineCount) {
-        startIndex = index + 1;
-      } else if ((networkItem + 1) == newLineCount) {
-        endIndex = index;
-        break;
-      }
-    }
-  }
-
-  if (index >= _scanExtendedResponse.length()) {
-    return 0;
+  if (strstr(line, "\r\n") != NULL) {
+    // the last line of the response
+    _scan.received = 1;
   }
+}
 
+int WiFiClass::parseScanNetwork(const char* line)
+{
   int bssid[6] = { 0, 0, 0, 0, 0, 0 };
   int frequency = 0;
   int rssi = 0;
   char flags[64 + 1];
+  char ssid[32 + 1];
   int channel = 0;
   uint8_t encType = ENC_TYPE_UNKNOWN;
 
-  _scanCache.ssid[0] = '\0';
+  ssid[0] = '\0';
 
-  _scanExtendedResponse.setCharAt(endIndex, '\0');
-
-  sscanf(
-    _scanExtendedResponse.c_str() + startIndex,
-    "%x:%x:%x:%x:%x:%x\t%d\t%d\t%64s\t%32[^\t\n]",
+  int fields = sscanf(
+    line,
+    "%x:%x:%x:%x:%x:%x\t%d\t%d\t%64s\t%32[^\t\r\n]",
     &bssid[5], &bssid[4], &bssid[3], &bssid[2], &bssid[1], &bssid[0],
     &frequency,
     &rssi,
     flags,
-    _scanCache.ssid
+    ssid
   );
 
-  _scanExtendedResponse.setCharAt(endIndex, '\n');
+  if (fields < 9) {
+    return 0;
+  }
 
   // https://en.wikipedia.org/wiki/List_of_WLAN_channels#2.4_GHz_(802.11b/g/n/ax)
   switch (frequency) {
@@ -932,17 +1715,128 @@ int WiFiClass::parseScanNetworksItem(uint8_t networkItem)
     encType = ENC_TYPE_NONE;
   }
 
-  _scanCache.networkItem = networkItem;
-  _scanCache.encryptionType = encType;
+  if (_scan.ssid[0] != '\0' && strcmp(ssid, _scan.ssid) != 0) {
+    return 0;
+  }
+
+  if (_scan.channels != 0 && (_scan.channels & (1 << channel)) == 0) {
+    return 0;
+  }
+
+  int index = _scan.count;
+
+  if ((_scan.options & WL_SCAN_UNIQUE_SSID) && ssid[0] != '\0') {
+    // keep the strongest access point of each network, hidden ones are all kept
+    for (int i = 0; i < _scan.count; i++) {
+      if (strcmp(_scan.networks[i].ssid, ssid) != 0) {
+        continue;
+      }
+
+      if (_scan.networks[i].rssi >= rssi) {
+        return 1;
+      }
+
+      _scan.count--;
+      memmove(&_scan.networks[i], &_scan.networks[i + 1], (_scan.count - i) * sizeof(_scan.networks[0]));
+      // the stronger one takes its place, or moves up when sorting
+      index = i;
+      break;
+    }
+  }
+
+  if (_scan.options & WL_SCAN_SORT_RSSI) {
+    while (index > 0 && _scan.networks[index - 1].rssi < rssi) {
+      index--;
+    }
+  }
+
+  if (index >= WIFI_SCAN_MAX_NETWORKS) {
+    return 1;
+  }
+
+  if (_scan.count >= WIFI_SCAN_MAX_NETWORKS) {
+    // the table is full, drop the last one
+    _scan.count--;
+  }
+
+  memmove(&_scan.networks[index + 1], &_scan.networks[index], (_scan.count - index) * sizeof(_scan.networks[0]));
+
+  strcpy(_scan.networks[index].ssid, ssid);
   for (int i = 0; i < 6; i++) {
-    _scanCache.bssid[i] = bssid[i];
+    _scan.networks[index].bssid[i] = bssid[i];
+  }
+  _scan.networks[index].encryptionType = encType;
+  _scan.networks[index].channel = channel;
+  _scan.networks[index].rssi = rssi;
+
+  _scan.count++;
+
+  return 1;
+}
+
+int WiFiClass::refreshLink()
+{
+  _ssid[0] = '\0';
+  memset(_link.bssid, 0x00, sizeof(_link.bssid));
+  _link.encryptionType = ENC_TYPE_UNKNOWN;
+  _link.info = 0;
+
+  if (this->AT("+WFSTAT") != 0 || !_extendedResponse.startsWith("+WFSTAT:")) {
+    return 0;
+  }
+
+  // one query fills in the status and all of the connection info
+  int bssidIndex = _extendedResponse.indexOf("\nbssid=");
+  if (bssidIndex != -1) {
+    int bssid[6] = { 0, 0, 0, 0, 0, 0 };
+
+    sscanf(
+      _extendedResponse.c_str() + bssidIndex + 1, "bssid=%x:%x:%x:%x:%x:%x\n",
+      &bssid[5], &bssid[4], &bssid[3], &bssid[2], &bssid[1], &bssid[0]
+    );
+
+    for (int i = 0; i < 6; i++) {
+      _link.bssid[i] = bssid[i];
+    }
+  }
+
+  int ssidIndex = _extendedResponse.indexOf("\nssid=");
+  if (ssidIndex != -1) {
+    sscanf(_extendedResponse.c_str() + ssidIndex + 1, "ssid=%32[^\n]\n", _ssid);
   }
-  _scanCache.channel = channel;
-  _scanCache.rssi = rssi;
+
+  if (_extendedResponse.indexOf("key_mgmt=WPA2-AUTO") != -1) { // TODO: verify
+    _link.encryptionType = ENC_TYPE_AUTO;
+  } else if (_extendedResponse.indexOf("key_mgmt=WPA2-PSK") != -1) {
+    _link.encryptionType = ENC_TYPE_CCMP;
+  } else if (_extendedResponse.indexOf("key_mgmt=WPA-PSK") != -1) {
+    _link.encryptionType = ENC_TYPE_TKIP;
+  } else if (_extendedResponse.indexOf("group_cipher=WEP") != -1) {
+    _link.encryptionType = ENC_TYPE_WEP;
+  } else if (_extendedResponse.indexOf("key_mgmt=NONE") != -1) {
+    _link.encryptionType = ENC_TYPE_NONE;
+  }
+
+  if (_interface == 1 && _link.encryptionType == ENC_TYPE_UNKNOWN) {
+    _link.encryptionType = ENC_TYPE_NONE;
+  }
+
+  if (_interface == 0) {
+    _status = (_extendedResponse.indexOf("bssid=") != -1) ? WL_CONNECTED : WL_DISCONNECTED;
+    _link.known = 1;
+  }
+
+  _link.info = 1;
+  _link.refreshed = millis();
 
   return 1;
 }
 
+int WiFiClass::refreshDue()
+{
+  return (_link.refreshInterval != 0 && (millis() - _link.refreshed) >= _link.refreshInterval);
+}
+
 int WiFiClass::getNetworkIpInfo(int* iface, uint32_t* ipAddr, uint32_t* netmask, uint32_t* gw)
 {
   if (this->AT("+NWIP=?") == 0 && _extendedResponse.startsWith("+NWIP:")) {
@@ -982,125 +1876,121 @@ int WiFiClass::getNetworkIpInfo(int* iface, uint32_t* ipAddr, uint32_t* netmask,
   return 0;
 }
 
-void WiFiClass::onExtendedResponseHandler(void* context, const char* prefix, Stream& s)
+void WiFiClass::onExtendedResponseHandler(void* context, const char* response)
 {
-  ((WiFiClass*)context)->handleExtendedResponse(prefix, s);
+  ((WiFiClass*)context)->handleExtendedResponse(response);
 }
 
-void WiFiClass::handleExtendedResponse(const char* prefix, Stream& s)
+void WiFiClass::handleExtendedResponse(const char* response)
 {
-  if (strcmp("+TRDTC:", prefix) == 0 || strcmp("+TRDTS:", prefix) == 0 || strcmp("+TRDUS:", prefix) == 0) {
-    int commaCount = 0;
-
-    _extendedResponse = "";
+  if (strncmp(response, "+WFSCAN:", 8) == 0) {
+    // streamed a network at a time and parsed straight into the scan table
+    if (_scan.result == WL_SCAN_RUNNING && _scan.ticket == _modem.currentTicket()) {
+      parseScanNetworks(response + 8);
+    }
+    return;
+  }
 
-    while (1) {
-      if (s.available()) {
-        char c = s.read();
+  if (strncmp(response, "+NWHOST:", 8) == 0) {
+    for (int i = 0; i < WIFI_HOST_LOOKUP_MAX; i++) {
+      if (_hostLookups[i].state == LOOKUP_SENT && _hostLookups[i].ticket == _modem.currentTicket()) {
+        int ipAddr[4] = { 0, 0, 0, 0 };
 
-        _extendedResponse += c;
+        sscanf(
+          response, "+NWHOST:%d.%d.%d.%d\n",
+          &ipAddr[0], &ipAddr[1], &ipAddr[2], &ipAddr[3]
+        );
 
-        if (c == ',') {
-          commaCount++;
+        _hostLookups[i].result = IPAddress(ipAddr[0], ipAddr[1], ipAddr[2], ipAddr[3]);
+        return;
+      }
+    }
+  }
 
-          if (commaCount == 4) {
-            int cid;
-            int ipAddrOctets[4] = {0, 0, 0, 0};
-            int port;
-            int length;
+  _extendedResponse = response;
 
-            sscanf(
-              _extendedResponse.c_str(),
-              "%d,%d.%d.%d.%d,%d,%d,",
-              &cid,
-              &ipAddrOctets[0], &ipAddrOctets[1], &ipAddrOctets[2], &ipAddrOctets[3],
-              &port, &length
-            );
+  if (_extendedResponse.startsWith("+WFJAP:1")) {
+    _status = WL_CONNECTED;
+    _link.known = 1;
+    _link.info = 0;
+  } else if (_extendedResponse.startsWith("+WFJAP:0")) {
+    _status = WL_CONNECT_FAILED;
+    _link.known = 1;
+    _link.info = 0;
+  } else if (_extendedResponse.startsWith("+WFDAP:")) {
+    _status = WL_CONNECTION_LOST;
+    _link.known = 1;
+    _link.info = 0;
+    _callbacks.linkDownPending = 1;
+  } else if (_extendedResponse.startsWith("+WFCST:")) {
+    _status = WL_AP_CONNECTED;
+    _numConnectedSta++;
+  } else if (_extendedResponse.startsWith("+WFDST:")) {
+    _numConnectedSta--;
+    if (_numConnectedSta < 1) {
+      _status = WL_AP_LISTENING;
+    }
+  } else if (_extendedResponse.startsWith("+TRXTC:1")) {
+    _socketBuffer.close(1);
+  } else if (_extendedResponse.startsWith("+TRCTS:0")) {
+    int cid;
+    int ipAddrOctets[4] = {0, 0, 0, 0};
+    int port;
 
-            _socketBuffer.receive(cid, IPAddress(ipAddrOctets[0], ipAddrOctets[1], ipAddrOctets[2], ipAddrOctets[3]), port, s, length);
+    sscanf(
+      _extendedResponse.c_str(),
+      "+TRCTS:%d,%d.%d.%d.%d,%d",
+      &cid,
+      &ipAddrOctets[0], &ipAddrOctets[1], &ipAddrOctets[2], &ipAddrOctets[3],
+      &port
+    );
 
-            break;
-          }
-        }
-      }
+    if (WiFiServer::_inst != NULL) {
+      WiFiServer::_inst->connect(cid, IPAddress(ipAddrOctets[0], ipAddrOctets[1], ipAddrOctets[2], ipAddrOctets[3]), port);
     }
-  } else {
-    _extendedResponse = prefix;
-
-    while (1) {
-      if (s.available()) {
-        char c = s.read();
+  } else if (_extendedResponse.startsWith("+TRXTS:0")) {
+    int cid;
+    int ipAddrOctets[4] = {0, 0, 0, 0};
+    int port;
 
-        _extendedResponse += c;
+    sscanf(
+      _extendedResponse.c_str(),
+      "+TRXTS:%d,%d.%d.%d.%d,%d",
+      &cid,
+      &ipAddrOctets[0], &ipAddrOctets[1], &ipAddrOctets[2], &ipAddrOctets[3],
+      &port
+    );
 
-        if (c == '\n') {
-          if (_extendedResponse.endsWith("\r\n")) {
-            break;
-          }
-        }
-      }
+    if (WiFiServer::_inst != NULL) {
+      WiFiServer::_inst->disconnect(cid, IPAddress(ipAddrOctets[0], ipAddrOctets[1], ipAddrOctets[2], ipAddrOctets[3]), port);
     }
+  } else if (_extendedResponse.startsWith("+INIT:DONE,")) {
+    // the module restarted, does not answer earlier commands, and needs a new wakeup handshake
+    _modem.clearPending();
+    _awake = 0;
+    _link.known = 0;
+    _link.info = 0;
 
-    if (_extendedResponse.startsWith("+WFJAP:1")) {
-      _status = WL_CONNECTED;
-    } else if (_extendedResponse.startsWith("+WFJAP:0")) {
-      _status = WL_CONNECT_FAILED;
-    } else if (_extendedResponse.startsWith("+WFDAP:")) {
-      _status = WL_CONNECTION_LOST;
-    } else if (_extendedResponse.startsWith("+WFCST:")) {
-      _status = WL_AP_CONNECTED;
-      _numConnectedSta++;
-    } else if (_extendedResponse.startsWith("+WFDST:")) {
-      _numConnectedSta--;
-      if (_numConnectedSta < 1) {
-        _status = WL_AP_LISTENING;
-      }
-    } else if (_extendedResponse.startsWith("+TRXTC:1")) {
-      _socketBuffer.disconnect(1);
-    } else if (_extendedResponse.startsWith("+TRCTS:0")) {
-      int cid;
-      int ipAddrOctets[4] = {0, 0, 0, 0};
-      int port;
-
-      sscanf(
-        _extendedResponse.c_str(),
-        "+TRCTS:%d,%d.%d.%d.%d,%d",
-        &cid,
-        &ipAddrOctets[0], &ipAddrOctets[1], &ipAddrOctets[2], &ipAddrOctets[3],
-        &port
-      );
-
-      if (WiFiServer::_inst != NULL) {
-        WiFiServer::_inst->connect(cid, IPAddress(ipAddrOctets[0], ipAddrOctets[1], ipAddrOctets[2], ipAddrOctets[3]), port);
-      }
-    } else if (_extendedResponse.startsWith("+TRXTS:0")) {
-      int cid;
-      int ipAddrOctets[4] = {0, 0, 0, 0};
-      int port;
-
-      sscanf(
-        _extendedResponse.c_str(),
-        "+TRXTS:%d,%d.%d.%d.%d,%d",
-        &cid,
-        &ipAddrOctets[0], &ipAddrOctets[1], &ipAddrOctets[2], &ipAddrOctets[3],
-        &port
-      );
-
-      if (WiFiServer::_inst != NULL) {
-        WiFiServer::_inst->disconnect(cid, IPAddress(ipAddrOctets[0], ipAddrOctets[1], ipAddrOctets[2], ipAddrOctets[3]), port);
-      }
-    } else if (_extendedResponse.startsWith("+INIT:DONE,")) {
-      sscanf(
-        _extendedResponse.c_str(),
-        "+INIT:DONE,%d",
-        &_interface
-      );
-    } else if (_extendedResponse.startsWith("+RUN:") || _extendedResponse.startsWith("+INIT:WAKEUP,")) {
-      _run = 1;
-    }
+    sscanf(
+      _extendedResponse.c_str(),
+      "+INIT:DONE,%d",
+      &_interface
+    );
+  } else if (_extendedResponse.startsWith("+RUN:") || _extendedResponse.startsWith("+INIT:WAKEUP,")) {
+    _run = 1;
   }
 }
 
+void WiFiClass::onReceiveHandler(void* context, int cid, IPAddress ip, uint16_t port, int length, int offset, const uint8_t* data, int size)
+{
+  ((WiFiClass*)context)->handleReceive(cid, ip, port, length, offset, data, size);
+}
+
+void WiFiClass::handleReceive(int cid, IPAddress ip, uint16_t port, int length, int offset, const uint8_t* data, int size)
+{
+  _socketBuffer.receive(cid, ip, port, length, offset, data, size);
+}
+
 void WiFiClass::onIrq()
 {
   WiFi.handleIrq();
@@ -1109,6 +1999,8 @@ void WiFiClass::onIrq()
 void WiFiClass::handleIrq()
 {
   _irq = 1;
+
+  _modem.drain();
 }
 
-WiFiClass WiFi(SERIAL_PORT_HARDWARE, 5, 2);
+WiFiClass WiFi(WIFI_SERIAL_PORT, WIFI_RTC_WAKE_PIN, WIFI_WAKE_UP_PIN);
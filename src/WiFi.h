@@ -10,6 +10,7 @@
 
 #include <Arduino.h>
 
+#include "utility/WiFiHostCache.h"
 #include "utility/WiFiModem.h"
 #include "utility/WiFiSocketBuffer.h"
 
@@ -45,8 +46,89 @@ typedef enum {
   WL_PING_ERROR = -4
 } wl_ping_result_t;
 
+typedef enum {
+  WL_SELECT_READ = 0x01,
+  WL_SELECT_WRITE = 0x02
+} wl_select_event_t;
+
+typedef enum {
+  WL_SCAN_SORT_RSSI = 0x01,
+  WL_SCAN_UNIQUE_SSID = 0x02
+} wl_scan_option_t;
+
+typedef enum {
+  WL_SCAN_RUNNING = -1,
+  WL_SCAN_FAILED = -2
+} wl_scan_result_t;
+
+class WiFiClient;
+class WiFiServer;
+class WiFiUDP;
+
+// one socket for WiFi.select(...), set one of client, server or udp
+typedef struct {
+  WiFiClient* client;
+  WiFiServer* server;
+  WiFiUDP* udp;
+  uint8_t events;
+  uint8_t revents;
+} wl_select_t;
+
+// callbacks for WiFi.onData(...), WiFi.onAccept(...), WiFi.onClose(...) and WiFi.onLinkDown(...)
+typedef void (*wl_client_callback_t)(WiFiClient& client);
+typedef void (*wl_udp_callback_t)(WiFiUDP& udp);
+typedef void (*wl_callback_t)(void);
+// callback for WiFi.onHostByName(...), result is 0.0.0.0 if the lookup failed
+typedef void (*wl_host_callback_t)(int handle, const char* hostname, IPAddress result);
+// callback for WiFi.onScanNetworks(...), numSsid is WL_SCAN_FAILED if the scan failed
+typedef void (*wl_scan_callback_t)(int8_t numSsid);
+
 #define WIFI_FIRMWARE_LATEST_VERSION "3.1.2.0"
 
+// The modem connection can be overridden at build time, for example to bind
+// the library to another serial port or to a simulated modem on a host build
+#ifndef WIFI_SERIAL_PORT
+#define WIFI_SERIAL_PORT SERIAL_PORT_HARDWARE
+#endif
+
+#ifndef WIFI_RTC_WAKE_PIN
+#define WIFI_RTC_WAKE_PIN 5
+#endif
+
+#ifndef WIFI_WAKE_UP_PIN
+#define WIFI_WAKE_UP_PIN 2
+#endif
+
+#ifndef WIFI_SERIAL_BAUDRATE
+#define WIFI_SERIAL_BAUDRATE 115200
+#endif
+
+// define to switch to a higher baud rate once the module is initialized, for example 921600,
+// the module stays at WIFI_SERIAL_BAUDRATE if the higher rate does not work
+// #define WIFI_SERIAL_NEGOTIATE_BAUDRATE 921600
+
+// number of networks kept by WiFi.scanNetworks(), with WL_SCAN_SORT_RSSI the strongest ones
+#ifndef WIFI_SCAN_MAX_NETWORKS
+#define WIFI_SCAN_MAX_NETWORKS 16
+#endif
+
+// number of WiFi.beginHostByName(...) lookups that can be outstanding at once, they are
+// sent to the module as WIFI_BACKGROUND_MAX_PENDING allows
+#ifndef WIFI_HOST_LOOKUP_MAX
+#define WIFI_HOST_LOOKUP_MAX 4
+#endif
+
+// most commands in the modem queue when a host lookup or a scan is sent in the background,
+// so that blocking commands always find room in the queue
+#ifndef WIFI_BACKGROUND_MAX_PENDING
+#define WIFI_BACKGROUND_MAX_PENDING ((WIFI_MODEM_MAX_PENDING > 1) ? (WIFI_MODEM_MAX_PENDING - 1) : 1)
+#endif
+
+// define both to enable RTS/CTS flow control during initialization, the pins are
+// connected to the module's CTS and RTS signals
+// #define WIFI_SERIAL_RTS_PIN 6
+// #define WIFI_SERIAL_CTS_PIN 7
+
 class WiFiClass {
   public:
     WiFiClass(HardwareSerial& _serial, int rtcWakePin, int wakeUpPin);
@@ -81,17 +163,43 @@ class WiFiClass {
     uint8_t* BSSID(uint8_t* bssid);
     int32_t RSSI();
     uint8_t encryptionType();
+    // status() and the connection info are cached and kept current by the module's connection
+    // events, additionally refresh them from the module when older than interval milliseconds, 0 to never
+    void setStatusRefresh(unsigned long interval);
 
     int8_t scanNetworks();
+    // only keeps the networks named ssid
+    int8_t scanNetworks(const char* ssid);
+    // starts a scan without waiting for it, returns 0 if one is already running,
+    // the scan progresses on each poll, for example WiFi.loop()
+    int beginScanNetworks();
+    int beginScanNetworks(const char* ssid);
+    // returns the number of networks found once done, WL_SCAN_RUNNING or WL_SCAN_FAILED
+    int8_t scanComplete();
     const char* SSID(uint8_t networkItem);
     uint8_t encryptionType(uint8_t networkItem);
     uint8_t* BSSID(uint8_t networkItem, uint8_t* bssid);
     uint8_t channel(uint8_t networkItem);
     int32_t RSSI(uint8_t networkItem);
+    // WL_SCAN_SORT_RSSI (default) and WL_SCAN_UNIQUE_SSID, applied by the next scanNetworks()
+    void setScanOptions(uint8_t options);
+    // only keeps networks on the given channels, count 0 for all channels
+    void setScanChannels(const uint8_t* channels, int count);
 
     void end();
 
     int hostByName(const char* aHostname, IPAddress& aResult);
+    // resolved hostnames are cached, see WIFI_HOST_CACHE_SIZE
+    int prefetchHost(const char* hostname);
+    void invalidateHost(const char* hostname);
+    void invalidateHosts();
+    void setHostCacheTTL(unsigned long ttl, unsigned long negativeTtl);
+    // starts a lookup without waiting for it, returns a handle or 0 if too many are outstanding,
+    // lookups progress on each poll, for example WiFi.loop() or client.available()
+    int beginHostByName(const char* hostname);
+    // returns 1 and the address once resolved, 0 while pending and -1 if the lookup failed,
+    // the handle is released once the lookup is done
+    int checkHostByName(int handle, IPAddress& result);
 
     int ping(const char* hostname);
     int ping(const String &hostname);
@@ -102,8 +210,52 @@ class WiFiClass {
     void lowPowerMode();
     void noLowPowerMode();
 
+    // in low power mode, the module is allowed to sleep once it has been idle for this long (milliseconds)
+    void setSleepDelay(unsigned long delay);
+    // keeps the module awake between the calls, for grouping several operations, can be nested
+    void beginKeepAwake();
+    void endKeepAwake();
+    uint32_t wakeupCount();
+    uint32_t sleepCount();
+
     void setTimeout(unsigned long timeout);
 
+    // switches the module and the serial port to another baud rate, returns 0 and
+    // stays at the current rate if the module does not respond at the new one
+    int setBaudRate(unsigned long baudrate);
+    unsigned long baudRate();
+    // enables RTS/CTS flow control on the module and on the given pins, returns 0 and
+    // stays without flow control if the module does not respond with it
+    int flowControl(int rtsPin, int ctsPin);
+    void noFlowControl();
+
+    // callbacks are called from loop(), data callbacks are called on every loop() while data is available
+    void onData(wl_client_callback_t callback);
+    void onData(wl_udp_callback_t callback);
+    void onAccept(wl_client_callback_t callback);
+    void onClose(wl_client_callback_t callback);
+    void onLinkDown(wl_callback_t callback);
+    // called from loop() when a beginHostByName(...) lookup is done, releases its handle
+    void onHostByName(wl_host_callback_t callback);
+    // called from loop() when a beginScanNetworks() scan is done
+    void onScanNetworks(wl_scan_callback_t callback);
+    void loop();
+
+    // takes received bytes off the serial port, call it from long running code or a timer
+    // interrupt to keep the serial port buffer from overflowing, it is also called on the wake up interrupt
+    void drainSerial();
+    size_t rxHighWater();
+    uint32_t rxFull();
+
+    // waits up to timeout milliseconds for any of the sockets to become ready, and returns
+    // the number of ready sockets, the modem is polled once per pass for all of them
+    int select(wl_select_t* sockets, int count, unsigned long timeout);
+    void setBufferPool(uint8_t* buffer, size_t size);
+
+    // sends "AT" followed by command and args, returns 0 on OK, the module's error code on ERROR
+    // or -100 if the response did not arrive in time
+    int AT(const char* command = "", const char* args = NULL, int timeout = 2000);
+
     void debug(Print& p);
     void noDebug();
 
@@ -112,12 +264,23 @@ class WiFiClass {
     friend class WiFiServer;
     friend class WiFiUDP;
 
-    int AT(const char* command = "", const char* args = NULL, int timeout = 2000);
+    int AT(const char* const commands[], int count, int timeout = 2000);
     int ESC(const char* sequence, const char* args, const uint8_t* buffer, int length, int timeout = 1000);
+    int ESC(const char* sequence, const char* args, const wl_iovec_t* iov, int iovcnt, size_t offset, size_t length, int timeout = 1000);
+    int ESC(const char* sequence, const char* const args[], int count, const wl_iovec_t* iov, int iovcnt, size_t offset, size_t length, int timeout = 1000);
+    // sends count commands with send(context, modem, index, timeout), returns the number that
+    // succeeded and the first error in result, stops sending after it if stopOnError is set
+    int pipeline(int count, int timeout, int (*send)(void*, WiFiModem&, int, int), void* context, int stopOnError, int* result);
+
+    size_t send(int cid, IPAddress ip, uint16_t port, const wl_iovec_t* iov, int iovcnt);
+    int flush(int cid);
 
     void poll(unsigned long timeout);
 
     void wakeup();
+    void idle();
+    void checkSleep();
+    void sleep();
 
     WiFiSocketBuffer& socketBuffer();
 
@@ -125,20 +288,31 @@ class WiFiClass {
     int begin(const char* ssid, uint8_t key_idx, const char* key, uint8_t encType);
 
     int init();
+    int probeBaudRate();
 
     int setMode(int mode);
 
-    int parseScanNetworksItem(uint8_t networkItem);
+    void parseScanNetworks(const char* line);
+    int parseScanNetwork(const char* line);
+    void processScan();
+    int refreshLink();
+    int refreshDue();
     int getNetworkIpInfo(int* iface, uint32_t* ipAddr, uint32_t* netmask, uint32_t* gw);
 
-    static void onExtendedResponseHandler(void* context, const char* prefix, Stream& s);
-    void handleExtendedResponse(const char* prefix, Stream& s);
+    void processHostLookups();
+    void processWrites();
+
+    static void onExtendedResponseHandler(void* context, const char* response);
+    void handleExtendedResponse(const char* response);
+    static void onReceiveHandler(void* context, int cid, IPAddress ip, uint16_t port, int length, int offset, const uint8_t* data, int size);
+    void handleReceive(int cid, IPAddress ip, uint16_t port, int length, int offset, const uint8_t* data, int size);
     static void onIrq();
     void handleIrq();
 
   private:
     WiFiModem _modem;
     WiFiSocketBuffer _socketBuffer;
+    WiFiHostCache _hostCache;
     String _extendedResponse;
     volatile int _irq;
 
@@ -146,16 +320,37 @@ class WiFiClass {
     int _interface;
     int _numConnectedSta;
     char _ssid[32 + 1];
+    struct {
+      // the status is known from the events, the ssid, bssid and encryption type are current
+      int known;
+      int info;
+      uint8_t bssid[6];
+      uint8_t encryptionType;
+      unsigned long refreshed;
+      unsigned long refreshInterval;
+    } _link;
     char _firmwareVersion[sizeof(WIFI_FIRMWARE_LATEST_VERSION)];
-    String _scanExtendedResponse;
     struct {
-      uint8_t networkItem;
+      uint8_t options;
+      // bit n set for channel n, 0 for all channels
+      uint16_t channels;
       char ssid[32 + 1];
-      uint8_t encryptionType;
-      uint8_t bssid[6];
-      uint8_t channel;
-      int32_t rssi;
-    } _scanCache;
+      // 0 while queued, otherwise the ticket of the +WFSCAN command
+      int ticket;
+      unsigned long start;
+      int received;
+      // WL_SCAN_RUNNING, WL_SCAN_FAILED or the number of networks found
+      int8_t result;
+      int notify;
+      uint8_t count;
+      struct {
+        char ssid[32 + 1];
+        uint8_t bssid[6];
+        uint8_t encryptionType;
+        uint8_t channel;
+        int8_t rssi;
+      } networks[WIFI_SCAN_MAX_NETWORKS];
+    } _scan;
 
     struct {
       IPAddress localIp;
@@ -165,8 +360,47 @@ class WiFiClass {
 
     int _lowPowerMode;
     unsigned long _timeout;
+    unsigned long _baudRate;
+    int _flowControl;
 
     int _run;
+    // set once the wakeup handshake is done, cleared when the module may sleep or has restarted
+    int _awake;
+
+    unsigned long _sleepDelay;
+    int _sleepPending;
+    unsigned long _idleStart;
+    int _keepAwake;
+    uint32_t _wakeupCount;
+    uint32_t _sleepCount;
+
+    struct {
+      wl_client_callback_t data;
+      wl_udp_callback_t packet;
+      wl_client_callback_t accept;
+      wl_client_callback_t close;
+      wl_callback_t linkDown;
+      int linkDownPending;
+      wl_host_callback_t host;
+      wl_scan_callback_t scan;
+    } _callbacks;
+
+    enum {
+      LOOKUP_FREE,
+      LOOKUP_QUEUED,
+      LOOKUP_SENT,
+      LOOKUP_DONE
+    };
+
+    struct {
+      int state;
+      char hostname[WIFI_HOST_CACHE_NAME_SIZE + 1];
+      IPAddress result;
+      int ticket;
+      int retries;
+      int resent;
+      unsigned long start;
+    } _hostLookups[WIFI_HOST_LOOKUP_MAX];
 };
 
 extern WiFiClass WiFi;
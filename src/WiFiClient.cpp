@@ -20,7 +20,10 @@ WiFiClient::WiFiClient() :
 WiFiClient::WiFiClient(int cid, IPAddress remoteIp, uint16_t remotePort) :
   _cid(cid),
   _remoteIp(remoteIp),
-  _remotePort(remotePort)
+  _remotePort(remotePort),
+  _bufferSize(WIFI_SOCKET_TCP_BUFFER_SIZE),
+  _noDelay(true),
+  _writeDelay(WIFI_CLIENT_WRITE_DELAY)
 {
 }
 
@@ -39,11 +42,16 @@ int WiFiClient::connect(IPAddress ip, uint16_t port)
 
   stop();
 
+  if (!WiFi.socketBuffer().begin(1, _bufferSize)) {
+    return 0;
+  }
+
   char args[1 + 15 + 1 + 5 + 1 + 5 + 1];
 
   sprintf(args, "=%d.%d.%d.%d,%d,%d", ip[0], ip[1], ip[2], ip[3], port, 0);
 
   if (WiFi.AT("+TRTC", args, 10000) != 0) {
+    WiFi.socketBuffer().end(1);
     return 0;
   }
 
@@ -51,7 +59,6 @@ int WiFiClient::connect(IPAddress ip, uint16_t port)
   _cid = 1;
   _remoteIp = ip;
   _remotePort = port;
-  WiFi.socketBuffer().begin(_cid);
   WiFi.socketBuffer().clear(_cid);
   WiFi.socketBuffer().connect(_cid);
 
@@ -75,30 +82,78 @@ size_t WiFiClient::write(uint8_t b)
 }
 
 size_t WiFiClient::write(const uint8_t* buf, size_t size)
+{
+  wl_iovec_t iov = { buf, size };
+
+  return writev(&iov, 1);
+}
+
+size_t WiFiClient::writev(const wl_iovec_t* iov, int iovcnt)
 {
   if (_cid < 0) {
     return 0;
   }
 
-  if (size > 2048) {
-    size = 2048;
+  size_t total = 0;
+
+  for (int i = 0; i < iovcnt; i++) {
+    total += iov[i].size;
+  }
+
+  WiFiSocketBuffer& socketBuffer = WiFi.socketBuffer();
+  size_t held = socketBuffer.txAvailable(_cid);
+
+  if (held > 0 && !_noDelay && total > socketBuffer.txAvailableForStore(_cid) && iovcnt < 4 &&
+      socketBuffer.txRemoteIP(_cid) == _remoteIp && socketBuffer.txRemotePort(_cid) == _remotePort) {
+    // does not fit, send what is held back together with the new data
+    wl_iovec_t gather[4] = { { socketBuffer.txBuffer(_cid), held } };
+
+    for (int i = 0; i < iovcnt; i++) {
+      gather[i + 1] = iov[i];
+    }
+
+    size_t written = WiFi.send(_cid, _remoteIp, _remotePort, gather, iovcnt + 1);
+
+    // the held back bytes not sent yet stay for the next flush
+    socketBuffer.txConsume(_cid, written);
+
+    if (written < (held + total)) {
+      setWriteError();
+      return (written > held) ? (written - held) : 0;
+    }
+
+    return total;
+  }
+
+  if (held > 0 &&
+      (_noDelay || total > socketBuffer.txAvailableForStore(_cid) ||
+        socketBuffer.txRemoteIP(_cid) != _remoteIp || socketBuffer.txRemotePort(_cid) != _remotePort)) {
+    // send what is held back first, to keep the data in order
+    if (!WiFi.flush(_cid)) {
+      setWriteError();
+      return 0;
+    }
   }
 
-  char args[1 + 4 + 1 + 15 + 1 + 5 + 1 + 1];
+  if (_noDelay || total > socketBuffer.txAvailableForStore(_cid)) {
+    size_t written = WiFi.send(_cid, _remoteIp, _remotePort, iov, iovcnt);
 
-  sprintf(
-    args, "%d%d,%d.%d.%d.%d,%d,",
-    _cid, size,
-    _remoteIp[0], _remoteIp[1], _remoteIp[2], _remoteIp[3],
-    _remotePort
-  );
+    if (written < total) {
+      setWriteError();
+    }
+
+    return written;
+  }
 
-  if (WiFi.ESC("S", args, buf, size) != 0) {
+  for (int i = 0; i < iovcnt; i++) {
+    socketBuffer.txStore(_cid, _remoteIp, _remotePort, iov[i].buffer, iov[i].size, _writeDelay);
+  }
+
+  if (socketBuffer.txAvailableForStore(_cid) == 0 && !WiFi.flush(_cid)) {
     setWriteError();
-    return 0;
   }
 
-  return size;
+  return total;
 }
 
 int WiFiClient::available()
@@ -107,16 +162,23 @@ int WiFiClient::available()
     return 0;
   }
 
+  int socket = this->socket();
 
-  if (WiFi.socketBuffer().available(_cid) == 0) {
+  if (socket < 0 || WiFi.socketBuffer().available(socket) == 0) {
     WiFi.poll(0);
+
+    socket = this->socket();
   }
 
-  if (WiFi.socketBuffer().remoteIP(_cid) != _remoteIp || WiFi.socketBuffer().remotePort(_cid) != _remotePort) {
+  if (socket < 0) {
     return 0;
   }
 
-  return WiFi.socketBuffer().available(_cid);
+  if (WiFi.socketBuffer().remoteIP(socket) != _remoteIp || WiFi.socketBuffer().remotePort(socket) != _remotePort) {
+    return 0;
+  }
+
+  return WiFi.socketBuffer().available(socket);
 }
 
 int WiFiClient::read()
@@ -143,25 +205,96 @@ int WiFiClient::read(uint8_t* buf, size_t size)
     size = avail;
   }
 
-  return WiFi.socketBuffer().read(_cid, buf, size);
+  if (size == 0) {
+    return 0;
+  }
+
+  return WiFi.socketBuffer().read(socket(), buf, size);
 }
 
 int WiFiClient::peek()
 {
   if (available()) {
-    return WiFi.socketBuffer().peek(_cid);
+    return WiFi.socketBuffer().peek(socket());
   }
 
   return -1;
 }
 
+const uint8_t* WiFiClient::peekBuffer()
+{
+  int socket = this->socket();
+
+  if (socket < 0) {
+    return NULL;
+  }
+
+  return WiFi.socketBuffer().peekBuffer(socket);
+}
+
+size_t WiFiClient::peekAvailable()
+{
+  if (!available()) {
+    return 0;
+  }
+
+  return WiFi.socketBuffer().peekAvailable(socket());
+}
+
+void WiFiClient::peekConsume(size_t size)
+{
+  int socket = this->socket();
+
+  if (socket < 0) {
+    return;
+  }
+
+  WiFi.socketBuffer().peekConsume(socket, size);
+}
+
+uint32_t WiFiClient::droppedBytes()
+{
+  int socket = this->socket();
+
+  if (socket < 0) {
+    return 0;
+  }
+
+  return WiFi.socketBuffer().droppedBytes(socket);
+}
+
+uint32_t WiFiClient::droppedFrames()
+{
+  int socket = this->socket();
+
+  if (socket < 0) {
+    return 0;
+  }
+
+  return WiFi.socketBuffer().droppedFrames(socket);
+}
+
 void WiFiClient::flush()
 {
+  if (_cid < 0) {
+    return;
+  }
+
+  if (WiFi.socketBuffer().txAvailable(_cid) > 0 && !WiFi.flush(_cid)) {
+    setWriteError();
+  }
 }
 
 void WiFiClient::stop()
 {
   if (_cid > -1) {
+    flush();
+
+    if (WiFi.socketBuffer().txRemoteIP(_cid) == _remoteIp && WiFi.socketBuffer().txRemotePort(_cid) == _remotePort) {
+      // what could not be sent goes with the connection
+      WiFi.socketBuffer().txClear(_cid);
+    }
+
     if (_cid == 0) {
       if (WiFiServer::_inst != NULL) {
         WiFiServer::_inst->begin();
@@ -173,6 +306,11 @@ void WiFiClient::stop()
     WiFi.socketBuffer().clear(_cid);
     WiFi.socketBuffer().disconnect(_cid);
 
+    if (_cid != 0) {
+      // return the receive buffer to the pool, the server one stays with the server
+      WiFi.socketBuffer().end(_cid);
+    }
+
     _cid = -1;
     _remoteIp = (uint32_t)0;
     _remotePort = 0;
@@ -189,17 +327,65 @@ uint8_t WiFiClient::connected()
     return 0;
   }
 
-  WiFi._modem.poll(0);
+  WiFi.poll(0);
 
-  if (_cid == 0) {
-    if (WiFiServer::_inst != NULL) {
-      return WiFiServer::_inst->connected(_cid, _remoteIp, _remotePort);
-    }
+  int socket = this->socket();
+
+  if (socket < 0) {
+    return 0;
+  }
 
+  return WiFi.socketBuffer().available(socket) || WiFi.socketBuffer().connected(socket);
+}
+
+void WiFiClient::setBufferSize(size_t size)
+{
+  _bufferSize = size;
+}
+
+void WiFiClient::setNoDelay(bool noDelay)
+{
+  _noDelay = noDelay;
+}
+
+bool WiFiClient::getNoDelay()
+{
+  return _noDelay;
+}
+
+void WiFiClient::setWriteDelay(unsigned long delay)
+{
+  _writeDelay = delay;
+}
+
+uint8_t WiFiClient::ready()
+{
+  if (_cid < 0) {
     return 0;
   }
 
-  return WiFi.socketBuffer().available(_cid) || WiFi.socketBuffer().connected(_cid);
+  int socket = this->socket();
+
+  if (socket < 0) {
+    // the peer is gone, reading returns straight away
+    return WL_SELECT_READ;
+  }
+
+  if (WiFi.socketBuffer().available(socket) || !WiFi.socketBuffer().connected(socket)) {
+    return WiFi.socketBuffer().connected(socket) ? (WL_SELECT_READ | WL_SELECT_WRITE) : WL_SELECT_READ;
+  }
+
+  return WL_SELECT_WRITE;
+}
+
+int WiFiClient::socket()
+{
+  if (_cid == 0) {
+    // clients of the server are read through the socket of their peer
+    return WiFi.socketBuffer().peer(_remoteIp, _remotePort);
+  }
+
+  return _cid;
 }
 
 WiFiClient::operator bool()
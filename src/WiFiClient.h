@@ -9,10 +9,12 @@
 #define _WIFI_CLIENT_H_
 
 #include <Client.h>
-#if __has_include(<api/RingBuffer.h>)
-#include <api/RingBuffer.h>
-#else
-#include <RingBuffer.h>
+
+#include "utility/WiFiModem.h"
+
+// default time small writes are held back for when no delay is disabled
+#ifndef WIFI_CLIENT_WRITE_DELAY
+#define WIFI_CLIENT_WRITE_DELAY 20
 #endif
 
 class WiFiClient : public Client {
@@ -24,10 +26,21 @@ class WiFiClient : public Client {
     virtual int connect(const char* host, uint16_t port);
     virtual size_t write(uint8_t);
     virtual size_t write(const uint8_t* buf, size_t size);
+    // sends the buffers as one framed write, split only at the module's maximum send size
+    size_t writev(const wl_iovec_t* iov, int iovcnt);
     virtual int available();
     virtual int read();
     virtual int read(uint8_t* buf, size_t size);
     virtual int peek();
+
+    // in place access to received data, without copying it out
+    const uint8_t* peekBuffer();
+    size_t peekAvailable();
+    void peekConsume(size_t size);
+
+    // data lost because the receive buffer was full or the modem stalled mid-frame
+    uint32_t droppedBytes();
+    uint32_t droppedFrames();
     virtual void flush();
     virtual void stop();
     virtual uint8_t connected();
@@ -38,17 +51,35 @@ class WiFiClient : public Client {
     virtual IPAddress remoteIP();
     virtual uint16_t remotePort();
 
+    // receive buffer size used by the next connect(...)
+    void setBufferSize(size_t size);
+
+    // when no delay is disabled small writes are combined and sent when the buffer fills,
+    // on flush() or after the write delay (in milliseconds)
+    void setNoDelay(bool noDelay);
+    bool getNoDelay();
+    void setWriteDelay(unsigned long delay);
+
   protected:
+    friend class WiFiClass;
     friend class WiFiServer;
 
+    uint8_t ready();
+
     WiFiClient(int cid, IPAddress remoteIp, uint16_t remotePort);
 
+  private:
+    int socket();
+
   private:
     static WiFiClient* _inst;
     
     int _cid;
     IPAddress _remoteIp;
     uint16_t _remotePort;
+    size_t _bufferSize;
+    bool _noDelay;
+    unsigned long _writeDelay;
 };
 
 #endif
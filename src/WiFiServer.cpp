@@ -14,7 +14,8 @@ WiFiServer* WiFiServer::_inst = NULL;
 
 WiFiServer::WiFiServer(uint16_t port) :
   _port(port),
-  _cid(-1)
+  _cid(-1),
+  _bufferSize(WIFI_SOCKET_TCP_BUFFER_SIZE)
 {
 }
 
@@ -29,23 +30,50 @@ WiFiClient WiFiServer::available(uint8_t* status)
 {
   (void)status;
 
+  if (_cid < 0) {
+    return WiFiClient(-1, (uint32_t)0, 0);
+  }
+
   for (int i = 0; i < 2; i++) {
-    if (WiFi._socketBuffer.available(_cid)) {
-      return WiFiClient(_cid, WiFi.socketBuffer().remoteIP(_cid), WiFi.socketBuffer().remotePort(_cid));
+    int socket = WiFi.socketBuffer().availablePeer();
+
+    if (socket > -1) {
+      return WiFiClient(_cid, WiFi.socketBuffer().remoteIP(socket), WiFi.socketBuffer().remotePort(socket));
     }
 
-    WiFi.poll(_cid);
+    WiFi.poll(0);
   }
 
   return WiFiClient(-1, (uint32_t)0, 0);
 }
 
+WiFiClient WiFiServer::accept()
+{
+  if (_cid < 0) {
+    return WiFiClient(-1, (uint32_t)0, 0);
+  }
+
+  WiFi.poll(0);
+
+  int socket = WiFi.socketBuffer().acceptPeer();
+
+  if (socket < 0) {
+    return WiFiClient(-1, (uint32_t)0, 0);
+  }
+
+  return WiFiClient(_cid, WiFi.socketBuffer().remoteIP(socket), WiFi.socketBuffer().remotePort(socket));
+}
+
 void WiFiServer::begin()
 {
   if (_inst != NULL && _inst != this) {
     return;
   }
 
+  if (!WiFi.socketBuffer().begin(0, _bufferSize)) {
+    return;
+  }
+
   WiFi.AT("+TRTRM", "=0", 5000);
   WiFi.AT("+TRSAVE", NULL, 5000);
 
@@ -59,12 +87,30 @@ void WiFiServer::begin()
 
   _cid = 0;
 
-  WiFi.socketBuffer().begin(_cid);
   WiFi.socketBuffer().clear(_cid);
 
   _inst = this;
 }
 
+void WiFiServer::stop()
+{
+  if (_cid < 0) {
+    return;
+  }
+
+  // send what is held back for one of the clients before the connections close
+  WiFi.flush(_cid);
+  WiFi.AT("+TRTRM", "=0", 5000);
+
+  WiFi.socketBuffer().end(_cid);
+
+  _cid = -1;
+
+  if (_inst == this) {
+    _inst = NULL;
+  }
+}
+
 size_t WiFiServer::write(uint8_t b)
 {
   return write(&b, sizeof(b));
@@ -74,74 +120,101 @@ size_t WiFiServer::write(const uint8_t *buf, size_t size)
 {
   size_t written = 0;
 
-  if (size > 2048) {
-    size = 2048;
+  if (_cid < 0) {
+    return 0;
   }
 
-  for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++) {
-    if ((uint32_t)_clients[i].remoteIp != 0 && _clients[i].remotePort != 0) {
-      char args[1 + 4 + 1 + 15 + 1 + 5 + 1 + 1];
-
-      sprintf(
-        args, "%d%d,%d.%d.%d.%d,%d,",
-        _cid, size,
-        _clients[i].remoteIp[0], _clients[i].remoteIp[1], _clients[i].remoteIp[2], _clients[i].remoteIp[3], 
-        _clients[i].remotePort
-      );
-
-      if (WiFi.ESC("S", args, buf, size) != 0) {
-        setWriteError();
-      } else {
-        written += size;
+  // keep the order with data held back by one of the clients
+  WiFi.flush(_cid);
+
+  char args[WIFI_SERVER_MAX_CLIENTS][1 + 4 + 1 + 15 + 1 + 5 + 1 + 1];
+  const char* peers[WIFI_SERVER_MAX_CLIENTS];
+  wl_iovec_t iov = { buf, size };
+
+  for (size_t offset = 0; offset < size;) {
+    size_t length = size - offset;
+    int count = 0;
+
+    if (length > WIFI_MODEM_MAX_SEND_SIZE) {
+      length = WIFI_MODEM_MAX_SEND_SIZE;
+    }
+
+    for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+      if (WiFi.socketBuffer().connected(i)) {
+        IPAddress remoteIp = WiFi.socketBuffer().remoteIP(i);
+
+        sprintf(
+          args[count], "%d%d,%d.%d.%d.%d,%d,",
+          _cid, (int)length,
+          remoteIp[0], remoteIp[1], remoteIp[2], remoteIp[3],
+          WiFi.socketBuffer().remotePort(i)
+        );
+
+        peers[count] = args[count];
+        count++;
       }
     }
+
+    if (count == 0) {
+      break;
+    }
+
+    // the payload is the same for every client, so the sends are pipelined
+    int sent = WiFi.ESC("S", peers, count, &iov, 1, offset, length);
+
+    if (sent < count) {
+      setWriteError();
+    }
+
+    written += sent * length;
+    offset += length;
   }
 
   return written;
 }
 
+void WiFiServer::setBufferSize(size_t size)
+{
+  _bufferSize = size;
+}
+
 uint8_t WiFiServer::status()
 {
   return 0;
 }
 
-void WiFiServer::connect(int cid, IPAddress ip, uint16_t port)
+uint8_t WiFiServer::ready()
 {
-  (void)cid;
+  if (_cid < 0) {
+    return 0;
+  }
 
-  for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++) {
-    if ((uint32_t)_clients[i].remoteIp == 0 && _clients[i].remotePort == 0) {
-      _clients[i].remoteIp = ip;
-      _clients[i].remotePort = port;
+  uint8_t events = 0;
 
+  if (WiFi.socketBuffer().peerReady()) {
+    events |= WL_SELECT_READ;
+  }
+
+  for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+    if (WiFi.socketBuffer().connected(i)) {
+      events |= WL_SELECT_WRITE;
       break;
     }
   }
+
+  return events;
 }
 
-bool WiFiServer::connected(int cid, IPAddress ip, uint16_t port)
+void WiFiServer::connect(int cid, IPAddress ip, uint16_t port)
 {
   (void)cid;
 
-  for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++) {
-    if (_clients[i].remoteIp == ip && _clients[i].remotePort == port) {
-      return true;
-    }
-  }
-
-  return false;
+  WiFi.socketBuffer().peerConnect(ip, port);
 }
 
 void WiFiServer::disconnect(int cid, IPAddress ip, uint16_t port)
 {
   (void)cid;
 
-  for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++) {
-    if (_clients[i].remoteIp == ip && _clients[i].remotePort == port) {
-      _clients[i].remoteIp = (uint32_t)0;
-      _clients[i].remotePort = 0;
-
-      break;
-    }
-  }
+  WiFi.socketBuffer().peerDisconnect(ip, port);
 }
@@ -14,9 +14,9 @@
 
 #include <Server.h>
 
-class WiFiClient;
+#include "utility/WiFiSocketBuffer.h"
 
-#define WIFI_SERVER_MAX_CLIENTS 8
+class WiFiClient;
 
 class WiFiServer : public Server {
   public:
@@ -24,11 +24,18 @@ class WiFiServer : public Server {
     virtual ~WiFiServer();
 
     WiFiClient available(uint8_t* status = NULL);
+    // returns each newly connected client once, even before it has sent any data
+    WiFiClient accept();
     void begin();
+    // closes the server socket and its clients, and returns the receive buffer to the pool
+    void stop();
     virtual size_t write(uint8_t);
     virtual size_t write(const uint8_t *buf, size_t size);
     uint8_t status();
 
+    // receive buffer size used by the next begin()
+    void setBufferSize(size_t size);
+
     using Print::write;
 
   protected:
@@ -37,17 +44,15 @@ class WiFiServer : public Server {
 
     static WiFiServer* _inst;
 
+    uint8_t ready();
+
     void connect(int cid, IPAddress ip, uint16_t port);
-    bool connected(int cid, IPAddress ip, uint16_t port);
     void disconnect(int cid, IPAddress ip, uint16_t port);
 
   private:
     uint16_t _port;
     int _cid;
-    struct {
-      IPAddress remoteIp;
-      uint16_t remotePort;
-    } _clients[WIFI_SERVER_MAX_CLIENTS];
+    size_t _bufferSize;
 };
 
 #endif
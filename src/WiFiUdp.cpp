@@ -12,7 +12,8 @@
 WiFiUDP* WiFiUDP::_inst = NULL;
 
 WiFiUDP::WiFiUDP() :
-  _txBufferIndex(0)
+  _txBufferIndex(0),
+  _bufferSize(WIFI_SOCKET_UDP_BUFFER_SIZE)
 {
 }
 
@@ -29,17 +30,21 @@ uint8_t WiFiUDP::begin(uint16_t port)
     return 0;
   }
 
+  if (!WiFi.socketBuffer().begin(2, _bufferSize)) {
+    return 0;
+  }
+
   char args[1 + 5 + 1];
 
   sprintf(args, "=%d", port);
 
   if (WiFi.AT("+TRUSE", args) != 0) {
+    WiFi.socketBuffer().end(2);
     return 0;
   }
 
   _inst = this;
   _txBufferIndex = 0;
-  WiFi.socketBuffer().begin(2);
   WiFi.socketBuffer().clear(2);
 
   return 1;
@@ -52,7 +57,7 @@ void WiFiUDP::stop()
 
     _inst = NULL;
     _txBufferIndex = 0;
-    WiFi.socketBuffer().clear(2);
+    WiFi.socketBuffer().end(2);
   }
 }
 
@@ -114,11 +119,9 @@ size_t WiFiUDP::write(const uint8_t* buffer, size_t size)
 
 int WiFiUDP::parsePacket()
 {
-  WiFi.socketBuffer().clear(2);
-
   WiFi.poll(0);
 
-  return WiFi.socketBuffer().available(2);
+  return WiFi.socketBuffer().nextPacket(2);
 }
 
 int WiFiUDP::available()
@@ -158,10 +161,53 @@ int WiFiUDP::peek()
   return -1;
 }
 
+const uint8_t* WiFiUDP::peekBuffer()
+{
+  return WiFi.socketBuffer().peekBuffer(2);
+}
+
+size_t WiFiUDP::peekAvailable()
+{
+  return WiFi.socketBuffer().peekAvailable(2);
+}
+
+void WiFiUDP::peekConsume(size_t size)
+{
+  WiFi.socketBuffer().peekConsume(2, size);
+}
+
+uint32_t WiFiUDP::droppedBytes()
+{
+  return WiFi.socketBuffer().droppedBytes(2);
+}
+
+uint32_t WiFiUDP::droppedFrames()
+{
+  return WiFi.socketBuffer().droppedFrames(2);
+}
+
 void WiFiUDP::flush()
 {
 }
 
+void WiFiUDP::setBufferSize(size_t size)
+{
+  _bufferSize = size;
+}
+
+uint8_t WiFiUDP::ready()
+{
+  if (_inst != this) {
+    return 0;
+  }
+
+  if (WiFi.socketBuffer().available(2) || WiFi.socketBuffer().packets(2)) {
+    return WL_SELECT_READ | WL_SELECT_WRITE;
+  }
+
+  return WL_SELECT_WRITE;
+}
+
 IPAddress WiFiUDP::remoteIP()
 {
   return WiFi.socketBuffer().remoteIP(2);
@@ -32,16 +32,34 @@ class WiFiUDP : public UDP {
     virtual int read(unsigned char* buffer, size_t len);
     virtual int read(char* buffer, size_t len);
     virtual int peek();
+
+    // in place access to received data, without copying it out
+    const uint8_t* peekBuffer();
+    size_t peekAvailable();
+    void peekConsume(size_t size);
+
+    // data lost because the receive buffer was full or the modem stalled mid-frame
+    uint32_t droppedBytes();
+    uint32_t droppedFrames();
     virtual void flush();
 
     virtual IPAddress remoteIP();
     virtual uint16_t remotePort();
 
+    // receive buffer size used by the next begin(...)
+    void setBufferSize(size_t size);
+
+  protected:
+    friend class WiFiClass;
+
+    uint8_t ready();
+
   private:
     static WiFiUDP* _inst;
 
     uint8_t _txBuffer[1500];
     int _txBufferIndex;
+    size_t _bufferSize;
 };
 
 #endif
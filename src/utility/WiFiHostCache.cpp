@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#include "WiFiHostCache.h"
+
+WiFiHostCache::WiFiHostCache() :
+  _ttl(WIFI_HOST_CACHE_TTL),
+  _negativeTtl(WIFI_HOST_CACHE_NEGATIVE_TTL)
+{
+  clear();
+}
+
+WiFiHostCache::~WiFiHostCache()
+{
+}
+
+void WiFiHostCache::setTTL(unsigned long ttl, unsigned long negativeTtl)
+{
+  _ttl = ttl;
+  _negativeTtl = negativeTtl;
+}
+
+int WiFiHostCache::lookup(const char* hostname, IPAddress& result)
+{
+#if WIFI_HOST_CACHE_SIZE > 0
+  int i = find(hostname);
+
+  if (i < 0) {
+    return 0;
+  }
+
+  if ((millis() - _entries[i].stored) >= _entries[i].ttl) {
+    _entries[i].hostname[0] = '\0';
+
+    return 0;
+  }
+
+  result = _entries[i].ip;
+
+  return ((uint32_t)result == 0) ? -1 : 1;
+#else
+  (void)hostname;
+  (void)result;
+
+  return 0;
+#endif
+}
+
+void WiFiHostCache::store(const char* hostname, IPAddress result)
+{
+#if WIFI_HOST_CACHE_SIZE > 0
+  if (strlen(hostname) > WIFI_HOST_CACHE_NAME_SIZE) {
+    return;
+  }
+
+  unsigned long now = millis();
+  int i = find(hostname);
+
+  if (i < 0) {
+    // take a free entry, otherwise replace the one closest to expiring
+    unsigned long remaining = (unsigned long)-1;
+
+    for (int j = 0; j < WIFI_HOST_CACHE_SIZE; j++) {
+      if (_entries[j].hostname[0] == '\0') {
+        i = j;
+        break;
+      }
+
+      unsigned long age = now - _entries[j].stored;
+      unsigned long left = (age < _entries[j].ttl) ? (_entries[j].ttl - age) : 0;
+
+      if (left < remaining) {
+        remaining = left;
+        i = j;
+      }
+    }
+  }
+
+  unsigned long ttl = ((uint32_t)result == 0) ? _negativeTtl : _ttl;
+
+  if (ttl == 0) {
+    _entries[i].hostname[0] = '\0';
+    return;
+  }
+
+  strcpy(_entries[i].hostname, hostname);
+  _entries[i].ip = result;
+  _entries[i].stored = now;
+  _entries[i].ttl = ttl;
+#else
+  (void)hostname;
+  (void)result;
+#endif
+}
+
+void WiFiHostCache::invalidate(const char* hostname)
+{
+#if WIFI_HOST_CACHE_SIZE > 0
+  int i = find(hostname);
+
+  if (i > -1) {
+    _entries[i].hostname[0] = '\0';
+  }
+#else
+  (void)hostname;
+#endif
+}
+
+void WiFiHostCache::clear()
+{
+#if WIFI_HOST_CACHE_SIZE > 0
+  for (int i = 0; i < WIFI_HOST_CACHE_SIZE; i++) {
+    _entries[i].hostname[0] = '\0';
+  }
+#endif
+}
+
+int WiFiHostCache::find(const char* hostname)
+{
+#if WIFI_HOST_CACHE_SIZE > 0
+  for (int i = 0; i < WIFI_HOST_CACHE_SIZE; i++) {
+    if (_entries[i].hostname[0] != '\0' && strcasecmp(_entries[i].hostname, hostname) == 0) {
+      return i;
+    }
+  }
+#else
+  (void)hostname;
+#endif
+
+  return -1;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _WIFI_HOST_CACHE_H_
+#define _WIFI_HOST_CACHE_H_
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+// number of resolved hostnames kept by WiFi.hostByName(...), 0 to disable the cache
+#ifndef WIFI_HOST_CACHE_SIZE
+#define WIFI_HOST_CACHE_SIZE 4
+#endif
+
+// longer hostnames are always resolved by the module
+#ifndef WIFI_HOST_CACHE_NAME_SIZE
+#define WIFI_HOST_CACHE_NAME_SIZE 63
+#endif
+
+// the module does not report record TTLs, so entries expire after a fixed time (milliseconds),
+// hostnames that could not be resolved are remembered for a shorter time
+#ifndef WIFI_HOST_CACHE_TTL
+#define WIFI_HOST_CACHE_TTL (60 * 1000UL)
+#endif
+
+#ifndef WIFI_HOST_CACHE_NEGATIVE_TTL
+#define WIFI_HOST_CACHE_NEGATIVE_TTL (10 * 1000UL)
+#endif
+
+class WiFiHostCache {
+  public:
+    WiFiHostCache();
+    virtual ~WiFiHostCache();
+
+    void setTTL(unsigned long ttl, unsigned long negativeTtl);
+
+    // returns 1 and the address if cached, -1 if cached as unresolvable, 0 if not cached or expired
+    int lookup(const char* hostname, IPAddress& result);
+    // an address of 0.0.0.0 caches the hostname as unresolvable
+    void store(const char* hostname, IPAddress result);
+    void invalidate(const char* hostname);
+    void clear();
+
+  private:
+    int find(const char* hostname);
+
+  private:
+    unsigned long _ttl;
+    unsigned long _negativeTtl;
+
+#if WIFI_HOST_CACHE_SIZE > 0
+    struct {
+      char hostname[WIFI_HOST_CACHE_NAME_SIZE + 1];
+      IPAddress ip;
+      unsigned long stored;
+      unsigned long ttl;
+    } _entries[WIFI_HOST_CACHE_SIZE];
+#endif
+};
+
+#endif
@@ -15,8 +15,29 @@ WiFiModem::WiFiModem(HardwareSerial& serial, int rtcWakePin, int wakeUpPin) :
   _serial(&serial),
   _rtcWakePin(rtcWakePin),
   _wakeUpPin(wakeUpPin),
-  _debug(NULL)
+  _rtsPin(-1),
+  _ctsPin(-1),
+  _rtsHigh(false),
+  _draining(false),
+  _debug(NULL),
+  _state(STATE_LINE),
+  _lastReceive(0),
+  _nextTicket(1),
+  _oldestTicket(1),
+  _abandonedTicket(0),
+  _abandonedAt(0),
+  _lineIndex(0),
+  _streamPrefix(NULL),
+  _responseStreamed(false),
+  _responseLong(false),
+#if WIFI_MODEM_RX_BUFFER_SIZE > 0
+  _rxHead(0),
+  _rxTail(0),
+#endif
+  _rxHighWater(0),
+  _rxFull(0)
 {
+  _response.reserve(WIFI_MODEM_RESPONSE_SIZE);
 }
 
 WiFiModem::~WiFiModem()
@@ -31,19 +52,64 @@ void WiFiModem::begin(unsigned long baudrate)
   _serial->begin(baudrate);
 
   memset(&_extendedResponse, 0x00, sizeof(_extendedResponse));
+  memset(&_receive, 0x00, sizeof(_receive));
+
+  _state = STATE_LINE;
+  _oldestTicket = _nextTicket;
+  _lineIndex = 0;
+
+#if WIFI_MODEM_RX_BUFFER_SIZE > 0
+  noInterrupts();
+  _rxHead = 0;
+  _rxTail = 0;
+  interrupts();
+#endif
 }
 
 void WiFiModem::end()
 {
   _serial->end();
 
+  noFlowControl();
+
   pinMode(_rtcWakePin, INPUT);
   detachInterrupt(_wakeUpPin);
 }
 
 int WiFiModem::AT(const char* command, const char* args, unsigned long timeout)
 {
-  poll(0);
+  if (!beginCommand(timeout)) {
+    return WIFI_MODEM_TIMEOUT;
+  }
+
+  return waitForResponse(sendAT(command, args, timeout), timeout);
+}
+
+int WiFiModem::ESC(const char* sequence, const char* args, const uint8_t* buffer, int length, unsigned long timeout)
+{
+  wl_iovec_t iov = { buffer, (size_t)length };
+
+  return ESC(sequence, args, &iov, 1, 0, length, timeout);
+}
+
+int WiFiModem::ESC(const char* sequence, const char* args, const wl_iovec_t* iov, int iovcnt, size_t offset, size_t length, unsigned long timeout)
+{
+  if (!beginCommand(timeout)) {
+    return WIFI_MODEM_TIMEOUT;
+  }
+
+  return waitForResponse(sendESC(sequence, args, iov, iovcnt, offset, length, timeout), timeout);
+}
+
+int WiFiModem::sendAT(const char* command, const char* args, unsigned long timeout)
+{
+  process();
+
+  if (pending() >= WIFI_MODEM_MAX_PENDING) {
+    return 0;
+  }
+
+  clearWriteError();
 
   this->print("AT");
   this->print(command);
@@ -53,64 +119,185 @@ int WiFiModem::AT(const char* command, const char* args, unsigned long timeout)
   this->println();
   this->flush();
 
-  return waitForResponse(timeout);
+  if (getWriteError()) {
+    // the module did not take the whole command, there is no response to wait for
+    return 0;
+  }
+
+  return queueCommand(timeout);
 }
 
-int WiFiModem::ESC(const char* sequence, const char* args, const uint8_t* buffer, int length, unsigned long timeout)
+int WiFiModem::sendESC(const char* sequence, const char* args, const uint8_t* buffer, int length, unsigned long timeout)
+{
+  wl_iovec_t iov = { buffer, (size_t)length };
+
+  return sendESC(sequence, args, &iov, 1, 0, length, timeout);
+}
+
+int WiFiModem::sendESC(const char* sequence, const char* args, const wl_iovec_t* iov, int iovcnt, size_t offset, size_t length, unsigned long timeout)
 {
+  if (pending() >= WIFI_MODEM_MAX_PENDING) {
+    return 0;
+  }
+
+  clearWriteError();
+
   this->print("\e");
   this->print(sequence);
   if (args != NULL) {
     this->print(args);
   }
-  if (length > 0) {
-    this->write(buffer, length);
+
+  // write length bytes, starting offset bytes into the concatenated buffers
+  for (int i = 0; i < iovcnt && length > 0 && !getWriteError(); i++) {
+    if (offset >= iov[i].size) {
+      offset -= iov[i].size;
+      continue;
+    }
+
+    size_t size = iov[i].size - offset;
+
+    if (size > length) {
+      size = length;
+    }
+
+    this->write(iov[i].buffer + offset, size);
+
+    offset = 0;
+    length -= size;
   }
   this->flush();
 
-  return waitForResponse(timeout);
+  if (getWriteError()) {
+    return 0;
+  }
+
+  return queueCommand(timeout);
 }
 
-void WiFiModem::poll(unsigned long timeout) {
-  int bufferIndex = 0;
-  char buffer[32 + 1];
+int WiFiModem::responseCode(int ticket)
+{
+  process();
 
-  if (!this->available()) {
-    for (unsigned long start = millis(); (millis() - start) < timeout;) {
-      if (this->available()) {
-        break;
-      }
+  if (ticket <= 0 || ticket >= _nextTicket || (_nextTicket - ticket) > WIFI_MODEM_MAX_PENDING) {
+    // unknown ticket or result already recycled
+    return WIFI_MODEM_TIMEOUT;
+  }
+
+  if (ticket >= _oldestTicket && ticket <= _abandonedTicket) {
+    // given up on, still waiting to discard its response
+    return WIFI_MODEM_TIMEOUT;
+  }
+
+  return _responseCodes[ticket % WIFI_MODEM_MAX_PENDING];
+}
+
+int WiFiModem::waitForResponse(int ticket, unsigned long timeout)
+{
+  int result = WIFI_MODEM_TIMEOUT;
+  // responses arrive in order, so the commands sent before this one may use up their time first
+  unsigned long allowed = timeout + backlog(ticket);
+
+  for (unsigned long start = millis(); (millis() - start) < allowed;) {
+    result = responseCode(ticket);
+
+    if (result != WIFI_MODEM_PENDING) {
+      return result;
     }
+  }
+
+  if (result == WIFI_MODEM_PENDING) {
+    abandon(ticket);
+
+    result = WIFI_MODEM_TIMEOUT;
+  }
 
-    if (!this->available()) {
-      return;
+  return result;
+}
+
+void WiFiModem::abandon(int ticket)
+{
+  if (ticket < _oldestTicket || ticket >= _nextTicket) {
+    return;
+  }
+
+  // the commands keep their place in the queue, so their late responses are not taken for the
+  // responses of the following commands
+  if (ticket > _abandonedTicket) {
+    _abandonedTicket = ticket;
+  }
+
+  _abandonedAt = millis();
+}
+
+void WiFiModem::clearPending()
+{
+  while (_oldestTicket < _nextTicket) {
+    completeCommand(WIFI_MODEM_TIMEOUT);
+  }
+}
+
+int WiFiModem::pending()
+{
+  return _nextTicket - _oldestTicket;
+}
+
+int WiFiModem::currentTicket()
+{
+  return _oldestTicket;
+}
+
+void WiFiModem::process()
+{
+  if (_oldestTicket <= _abandonedTicket && (millis() - _abandonedAt) >= WIFI_MODEM_ABANDON_TIMEOUT) {
+    // the module is not going to answer them anymore
+    while (_oldestTicket <= _abandonedTicket) {
+      completeCommand(WIFI_MODEM_TIMEOUT);
     }
   }
 
-  timeout = 10;
+  if (!this->available()) {
+    if (_state != STATE_LINE && (millis() - _lastReceive) >= WIFI_MODEM_FRAME_TIMEOUT) {
+      abortFrame();
+    }
+
+    return;
+  }
 
-  for (unsigned long start = millis(); (millis() - start) < timeout;) {
-    if (this->available()) {
-      char c = this->read();
+  _lastReceive = millis();
 
-      buffer[bufferIndex++] = c;
+  while (this->available()) {
+    if (_state == STATE_DATA_PAYLOAD) {
+      processDataPayload();
+      continue;
+    }
 
-      if (c == '\n') {
-        bufferIndex = 0;
-      } else if (c == '+') {
-        start = millis();
-      } else if (c == ':' && buffer[0] == '+') {
-        buffer[bufferIndex] = '\0';
+    char c = this->read();
 
-        _extendedResponse.handler(_extendedResponse.context, buffer, *this);
+    switch (_state) {
+      case STATE_LINE:
+        processLine(c);
+        break;
 
+      case STATE_EXTENDED:
+        processExtended(c);
         break;
-      }
 
-      start = millis();
+      case STATE_DATA_HEADER:
+        processDataHeader(c);
+        break;
     }
   }
 }
+
+void WiFiModem::poll(unsigned long timeout)
+{
+  for (unsigned long start = millis(); !this->available() && (millis() - start) < timeout;) {
+  }
+
+  process();
+}
+
 void WiFiModem::wakeup()
 {
   digitalWrite(_rtcWakePin, HIGH);
@@ -118,12 +305,176 @@ void WiFiModem::wakeup()
   digitalWrite(_rtcWakePin, LOW);
 }
 
-void WiFiModem::onExtendedResponse(void(*handler)(void*, const char*, Stream&), void* context)
+void WiFiModem::setBaudRate(unsigned long baudrate)
+{
+  _serial->flush();
+  _serial->end();
+  _serial->begin(baudrate);
+
+  // responses still due at the previous rate are lost
+  clearPending();
+}
+
+void WiFiModem::flowControl(int rtsPin, int ctsPin)
+{
+  _rtsPin = rtsPin;
+  _ctsPin = ctsPin;
+
+  if (_rtsPin > -1) {
+    pinMode(_rtsPin, OUTPUT);
+    digitalWrite(_rtsPin, LOW);
+    _rtsHigh = false;
+  }
+
+  if (_ctsPin > -1) {
+    pinMode(_ctsPin, INPUT);
+  }
+}
+
+void WiFiModem::noFlowControl()
+{
+  if (_rtsPin > -1) {
+    pinMode(_rtsPin, INPUT);
+  }
+
+  _rtsPin = -1;
+  _ctsPin = -1;
+}
+
+void WiFiModem::onExtendedResponse(void(*handler)(void*, const char*), void* context)
 {
   _extendedResponse.handler = handler;
   _extendedResponse.context = context;
 }
 
+void WiFiModem::streamExtendedResponse(const char* prefix)
+{
+  _streamPrefix = prefix;
+}
+
+void WiFiModem::onReceive(void(*handler)(void*, int, IPAddress, uint16_t, int, int, const uint8_t*, int), void* context)
+{
+  _receive.handler = handler;
+  _receive.context = context;
+}
+
+void WiFiModem::drain()
+{
+#if WIFI_MODEM_RX_BUFFER_SIZE > 0
+  // keep a single producer, this may be called from the main loop and interrupt handlers,
+  // an interrupt handler arriving while the main loop drains leaves the bytes to it
+  if (_draining) {
+    return;
+  }
+
+  _draining = true;
+
+  size_t head = _rxHead;
+  size_t tail = _rxTail;
+
+  // at most what is already in the serial port, so the call stays short
+  for (int avail = _serial->available(); avail > 0; avail--) {
+    size_t next = (head + 1) % sizeof(_rxBuffer);
+
+    if (next == tail) {
+      // the rest stays in the serial port buffer
+      _rxFull++;
+      break;
+    }
+
+    _rxBuffer[head] = _serial->read();
+    head = next;
+  }
+
+  // the bytes are in the ring before the consumer can see them
+  __asm__ __volatile__("" ::: "memory");
+  _rxHead = head;
+
+  size_t used = (head + sizeof(_rxBuffer) - tail) % sizeof(_rxBuffer);
+
+  if (used > _rxHighWater) {
+    _rxHighWater = used;
+  }
+
+  updateRts(used);
+
+  _draining = false;
+#endif
+}
+
+void WiFiModem::updateRts(size_t used)
+{
+#if WIFI_MODEM_RX_BUFFER_SIZE > 0
+  if (_rtsPin < 0) {
+    return;
+  }
+
+  // ask the module to stop sending while less than a quarter of the ring is free
+  bool high = (sizeof(_rxBuffer) - used) < (sizeof(_rxBuffer) / 4);
+
+  if (high != _rtsHigh) {
+    digitalWrite(_rtsPin, high ? HIGH : LOW);
+    _rtsHigh = high;
+  }
+#endif
+}
+
+size_t WiFiModem::rxHighWater()
+{
+  return _rxHighWater;
+}
+
+uint32_t WiFiModem::rxFull()
+{
+  return _rxFull;
+}
+
+size_t WiFiModem::rxRead(uint8_t* data, size_t size)
+{
+#if WIFI_MODEM_RX_BUFFER_SIZE > 0
+  size_t count = 0;
+
+  while (count < size) {
+    if (_rxTail == _rxHead) {
+      drain();
+
+      if (_rxTail == _rxHead) {
+        break;
+      }
+    }
+
+    size_t tail = _rxTail;
+    size_t head = _rxHead;
+    size_t chunk = ((head >= tail) ? head : sizeof(_rxBuffer)) - tail;
+
+    if (chunk > (size - count)) {
+      chunk = size - count;
+    }
+
+    memcpy(data + count, _rxBuffer + tail, chunk);
+    // the bytes are copied before the producer can reuse their room
+    __asm__ __volatile__("" ::: "memory");
+    _rxTail = (tail + chunk) % sizeof(_rxBuffer);
+    count += chunk;
+  }
+
+  if (_rtsHigh) {
+    // let the module send again once the ring has emptied enough
+    drain();
+  }
+
+  return count;
+#else
+  size_t count = 0;
+
+  for (int avail = _serial->available(); avail > 0 && count < size; avail--) {
+    data[count++] = _serial->read();
+  }
+
+  return count;
+#endif
+}
+
 void WiFiModem::onIrq(void (*handler)(void))
 {
   pinMode(_wakeUpPin, INPUT_PULLUP);
@@ -135,12 +486,23 @@ void WiFiModem::onIrq(void (*handler)(void))
 
 int WiFiModem::available()
 {
+#if WIFI_MODEM_RX_BUFFER_SIZE > 0
+  drain();
+
+  return (_rxHead + sizeof(_rxBuffer) - _rxTail) % sizeof(_rxBuffer);
+#else
   return _serial->available();
+#endif
 }
 
 int WiFiModem::read()
 {
-  int b = _serial->read();
+  uint8_t c;
+  int b = -1;
+
+  if (rxRead(&c, 1) == 1) {
+    b = c;
+  }
 
   if (_debug != NULL)  {
     if (b != -1) {
@@ -153,25 +515,68 @@ int WiFiModem::read()
 
 int WiFiModem::peek()
 {
+#if WIFI_MODEM_RX_BUFFER_SIZE > 0
+  if (!this->available()) {
+    return -1;
+  }
+
+  return _rxBuffer[_rxTail];
+#else
   return _serial->peek();
+#endif
 }
 
 size_t WiFiModem::write(uint8_t b)
 {
-  if (_debug != NULL)  {
-    _debug->write(b);
-  }
-
-  return _serial->write(b);
+  return write(&b, sizeof(b));
 }
 
 size_t WiFiModem::write(const uint8_t* buffer, size_t size)
 {
+  size_t written = 0;
+
+  while (written < size) {
+    if (_ctsPin > -1) {
+      // the module raises CTS when it can not take more data
+      unsigned long start = millis();
+
+      while (digitalRead(_ctsPin) != LOW && (millis() - start) < WIFI_MODEM_FLOW_TIMEOUT) {
+        drain();
+      }
+
+      if (digitalRead(_ctsPin) != LOW) {
+        break;
+      }
+    }
+
+    // small chunks, so little more is queued when CTS goes high, and a write blocked on a full
+    // transmit buffer does not keep received bytes from being taken off the serial port
+    size_t chunk = size - written;
+
+    if (chunk > 16) {
+      chunk = 16;
+    }
+
+    size_t count = _serial->write(buffer + written, chunk);
+
+    written += count;
+
+    drain();
+
+    if (count < chunk) {
+      break;
+    }
+  }
+
+  if (written < size) {
+    setWriteError();
+  }
+
   if (_debug != NULL)  {
-    _debug->write(buffer, size);
+    _debug->write(buffer, written);
   }
 
-  return _serial->write(buffer, size);
+  return written;
 }
 
 int WiFiModem::availableForWrite()
@@ -194,40 +599,225 @@ void WiFiModem::noDebug()
   _debug = NULL;
 }
 
-int WiFiModem::waitForResponse(unsigned long timeout)
+int WiFiModem::beginCommand(unsigned long timeout)
 {
-  int responseCode = -100;
+  // make room in the queue by waiting for the oldest command, for the rest of its own time
+  // and then timeout
+  unsigned long allowed = timeout + backlog(_oldestTicket + 1);
 
-  int bufferIndex = 0;
-  char buffer[32 + 1];
+  for (unsigned long start = millis(); pending() >= WIFI_MODEM_MAX_PENDING;) {
+    if ((millis() - start) >= allowed) {
+      abandon(_oldestTicket);
 
-  for (unsigned long start = millis(); (millis() - start) < timeout;) {
-    if (this->available()) {
-      char c = this->read();
+      return 0;
+    }
 
-      buffer[bufferIndex++] = c;
+    process();
+  }
 
-      if (c == '\n') {
-        buffer[bufferIndex] = '\0';
+  return 1;
+}
 
-        if (strcmp("OK\r\n", buffer) == 0) {
-          responseCode = 0;
-          break;
-        } else if (strncmp("ERROR:", buffer, 6) == 0) {
-          sscanf(buffer, "ERROR:%d\r\n", &responseCode);
-          break;
-        }
+void WiFiModem::completeCommand(int responseCode)
+{
+  if (_oldestTicket < _nextTicket) {
+    // the response of a command that was given up on is discarded
+    _responseCodes[_oldestTicket % WIFI_MODEM_MAX_PENDING] = (_oldestTicket <= _abandonedTicket) ? WIFI_MODEM_TIMEOUT : responseCode;
+    _oldestTicket++;
+  }
+}
 
-        bufferIndex = 0;
-      } else if (c == ':' && buffer[0] == '+') {
-        buffer[bufferIndex] = '\0';
+int WiFiModem::queueCommand(unsigned long timeout)
+{
+  int slot = _nextTicket % WIFI_MODEM_MAX_PENDING;
 
-        _extendedResponse.handler(_extendedResponse.context, buffer, *this);
+  _responseCodes[slot] = WIFI_MODEM_PENDING;
+  _sentAt[slot] = millis();
+  _timeouts[slot] = timeout;
 
-        bufferIndex = 0;
-      }
+  return _nextTicket++;
+}
+
+unsigned long WiFiModem::backlog(int ticket)
+{
+  // the longest time still allowed for any of the commands sent before ticket
+  unsigned long now = millis();
+  unsigned long longest = 0;
+
+  for (int i = _oldestTicket; i < ticket && i < _nextTicket; i++) {
+    int slot = i % WIFI_MODEM_MAX_PENDING;
+    unsigned long elapsed = now - _sentAt[slot];
+
+    if (i > _abandonedTicket && elapsed < _timeouts[slot] && (_timeouts[slot] - elapsed) > longest) {
+      longest = _timeouts[slot] - elapsed;
+    }
+  }
+
+  return longest;
+}
+
+void WiFiModem::processLine(char c)
+{
+  if (_lineIndex >= (int)(sizeof(_line) - 1)) {
+    // too long to be a response of interest, discard
+    _lineIndex = 0;
+  }
+
+  _line[_lineIndex++] = c;
+  _line[_lineIndex] = '\0';
+
+  if (c == '\n') {
+    if (strcmp("OK\r\n", _line) == 0) {
+      completeCommand(0);
+    } else if (strncmp("ERROR:", _line, 6) == 0) {
+      int responseCode = -1;
+
+      sscanf(_line, "ERROR:%d\r\n", &responseCode);
+
+      completeCommand(responseCode);
+    }
+
+    _lineIndex = 0;
+  } else if (c == ':' && _line[0] == '+') {
+    if (strcmp("+TRDTC:", _line) == 0 || strcmp("+TRDTS:", _line) == 0 || strcmp("+TRDUS:", _line) == 0) {
+      _state = STATE_DATA_HEADER;
+    } else {
+      _response = _line;
+      _responseStreamed = (_streamPrefix != NULL && strcmp(_streamPrefix, _line) == 0);
+      _state = STATE_EXTENDED;
+    }
+
+    _lineIndex = 0;
+  }
+}
+
+void WiFiModem::processExtended(char c)
+{
+  _response += c;
+
+  if (c != '\n') {
+    return;
+  }
+
+  bool end = _response.endsWith("\r\n");
+
+  if (!end && !_responseStreamed) {
+    return;
+  }
+
+  if (_response.length() > WIFI_MODEM_RESPONSE_SIZE) {
+    _responseLong = true;
+  }
+
+  if (_extendedResponse.handler != NULL) {
+    _extendedResponse.handler(_extendedResponse.context, _response.c_str());
+  }
+
+  if (!end) {
+    // the next line of a streamed response, behind the same prefix
+    _response = _streamPrefix;
+    return;
+  }
+
+  _state = STATE_LINE;
+
+  if (_responseLong) {
+    // give back the memory a long response took, assigning NULL frees the buffer
+    _response = (const char*)NULL;
+    _response.reserve(WIFI_MODEM_RESPONSE_SIZE);
+    _responseLong = false;
+  }
+}
+
+void WiFiModem::processDataHeader(char c)
+{
+  if (_lineIndex >= (int)(sizeof(_line) - 1)) {
+    // malformed header, resynchronize on the next line
+    _state = STATE_LINE;
+    _lineIndex = 0;
+    return;
+  }
+
+  _line[_lineIndex++] = c;
+  _line[_lineIndex] = '\0';
+
+  if (c != ',') {
+    return;
+  }
+
+  int commaCount = 0;
+
+  for (int i = 0; i < _lineIndex; i++) {
+    if (_line[i] == ',') {
+      commaCount++;
     }
   }
 
-  return responseCode;
+  if (commaCount < 4) {
+    return;
+  }
+
+  int ipAddrOctets[4] = {0, 0, 0, 0};
+  int port = 0;
+
+  _frame.cid = -1;
+  _frame.length = 0;
+  _frame.offset = 0;
+
+  sscanf(
+    _line,
+    "%d,%d.%d.%d.%d,%d,%d,",
+    &_frame.cid,
+    &ipAddrOctets[0], &ipAddrOctets[1], &ipAddrOctets[2], &ipAddrOctets[3],
+    &port, &_frame.length
+  );
+
+  _frame.remoteIp = IPAddress(ipAddrOctets[0], ipAddrOctets[1], ipAddrOctets[2], ipAddrOctets[3]);
+  _frame.remotePort = port;
+
+  _lineIndex = 0;
+  _state = STATE_DATA_PAYLOAD;
+
+  if (_frame.length <= 0) {
+    _frame.length = 0;
+
+    processDataPayload();
+  }
+}
+
+void WiFiModem::processDataPayload()
+{
+  uint8_t data[128];
+  int size = _frame.length - _frame.offset;
+
+  if (size > (int)sizeof(data)) {
+    size = sizeof(data);
+  }
+
+  // bypass read() for the payload, it is passed on as a single chunk
+  size = rxRead(data, size);
+
+  if (_debug != NULL) {
+    _debug->write(data, size);
+  }
+
+  if (_receive.handler != NULL) {
+    _receive.handler(_receive.context, _frame.cid, _frame.remoteIp, _frame.remotePort, _frame.length, _frame.offset, data, size);
+  }
+
+  _frame.offset += size;
+
+  if (_frame.offset >= _frame.length) {
+    _state = STATE_LINE;
+  }
+}
+
+void WiFiModem::abortFrame()
+{
+  if (_state == STATE_DATA_PAYLOAD && _receive.handler != NULL) {
+    _receive.handler(_receive.context, _frame.cid, _frame.remoteIp, _frame.remotePort, _frame.length, _frame.offset, NULL, _frame.length - _frame.offset);
+  }
+
+  _state = STATE_LINE;
+  _lineIndex = 0;
 }
@@ -9,6 +9,52 @@
 #define _WIFI_MODEM_H_
 
 #include <Arduino.h>
+#include <IPAddress.h>
+
+#define WIFI_MODEM_TIMEOUT -100
+#define WIFI_MODEM_PENDING -101
+
+// maximum number of commands written to the modem before their responses are received,
+// set to 1 to fully serialize commands
+#ifndef WIFI_MODEM_MAX_PENDING
+#define WIFI_MODEM_MAX_PENDING 4
+#endif
+
+// how long commands that were given up on keep their place in the queue while waiting for
+// their late response, after which any response is attributed to the following commands again
+#ifndef WIFI_MODEM_ABANDON_TIMEOUT
+#define WIFI_MODEM_ABANDON_TIMEOUT 10000
+#endif
+
+// memory kept for extended responses, longer ones are given back once handled
+#ifndef WIFI_MODEM_RESPONSE_SIZE
+#define WIFI_MODEM_RESPONSE_SIZE 64
+#endif
+
+// largest payload the modem accepts in a single ESC "S" send
+#define WIFI_MODEM_MAX_SEND_SIZE 2048
+
+// time without new bytes after which a partially received response or payload is abandoned
+#ifndef WIFI_MODEM_FRAME_TIMEOUT
+#define WIFI_MODEM_FRAME_TIMEOUT 100
+#endif
+
+// received bytes are moved from the serial port into a staging ring of this size, so they
+// can be taken off the serial port from an interrupt handler before it overflows, 0 to disable
+#ifndef WIFI_MODEM_RX_BUFFER_SIZE
+#define WIFI_MODEM_RX_BUFFER_SIZE 1024
+#endif
+
+// with flow control, the longest time to wait for the module to accept more data
+#ifndef WIFI_MODEM_FLOW_TIMEOUT
+#define WIFI_MODEM_FLOW_TIMEOUT 1000
+#endif
+
+// one buffer of a scatter/gather write
+typedef struct {
+  const uint8_t* buffer;
+  size_t size;
+} wl_iovec_t;
 
 class WiFiModem : public Stream {
   public:
@@ -17,15 +63,58 @@ class WiFiModem : public Stream {
 
     void begin(unsigned long baudrate);
     void end();
-
-    void onExtendedResponse(void (*handler)(void*, const char*, Stream&), void* context);
+    void setBaudRate(unsigned long baudrate);
+    // RTS/CTS handshaking on GPIO pins, RTS is driven from the staging ring fill level when
+    // drain() runs, so it does not protect the serial port's own receive buffer, writes wait
+    // while CTS is high
+    void flowControl(int rtsPin, int ctsPin);
+    void noFlowControl();
+
+    void onExtendedResponse(void (*handler)(void*, const char*), void* context);
+    // extended responses starting with prefix (such as "+WFSCAN:") are passed on a line at a
+    // time, each behind the prefix, the last one ends with "\r\n", instead of as a whole
+    void streamExtendedResponse(const char* prefix);
+    // payloads are passed on in chunks as (cid, ip, port, length, offset, data, size),
+    // data is NULL if the frame was abandoned with size bytes missing
+    void onReceive(void (*handler)(void*, int, IPAddress, uint16_t, int, int, const uint8_t*, int), void* context);
     void onIrq(void (*handler)(void));
 
     int AT(const char* command, const char* args, unsigned long timeout);
     int ESC(const char* sequence, const char* args, const uint8_t* buffer, int length, unsigned long timeout);
-
+    int ESC(const char* sequence, const char* args, const wl_iovec_t* iov, int iovcnt, size_t offset, size_t length, unsigned long timeout);
+
+    // non-blocking variants, return a ticket for responseCode() or 0 if too many commands are pending
+    // or the module did not accept the whole command within WIFI_MODEM_FLOW_TIMEOUT,
+    // responses are matched to tickets in the order the commands were sent, timeout is the time
+    // the command is allowed, which later blocking commands wait for in addition to their own
+    int sendAT(const char* command, const char* args, unsigned long timeout = 2000);
+    int sendESC(const char* sequence, const char* args, const uint8_t* buffer, int length, unsigned long timeout = 1000);
+    int sendESC(const char* sequence, const char* args, const wl_iovec_t* iov, int iovcnt, size_t offset, size_t length, unsigned long timeout = 1000);
+    int responseCode(int ticket);
+    // waits up to timeout milliseconds, after the time still allowed for the commands sent before it
+    int waitForResponse(int ticket, unsigned long timeout);
+    // gives up on the command and the ones sent before it, they report WIFI_MODEM_TIMEOUT
+    // and their late responses are discarded
+    void abandon(int ticket);
+    // gives up on all commands without waiting for their responses, for when the module
+    // can not answer them anymore
+    void clearPending();
+    // waits until another command can be sent, like AT() and ESC() do, returns 0 on timeout
+    int beginCommand(unsigned long timeout);
+    int pending();
+    // ticket of the oldest command still waiting for its response, extended responses
+    // received now belong to it
+    int currentTicket();
+
+    void process();
     void poll(unsigned long timeout);
 
+    // moves received bytes from the serial port into the staging ring, safe to call
+    // from an interrupt handler
+    void drain();
+    size_t rxHighWater();
+    uint32_t rxFull();
+
     void wakeup();
 
     // from Stream
@@ -43,19 +132,80 @@ class WiFiModem : public Stream {
     void noDebug();
 
   private:
-    int waitForResponse(unsigned long timeout);
+    void completeCommand(int responseCode);
+    int queueCommand(unsigned long timeout);
+    unsigned long backlog(int ticket);
+
+    void processLine(char c);
+    void processExtended(char c);
+    void processDataHeader(char c);
+    void processDataPayload();
+    void abortFrame();
+
+    size_t rxRead(uint8_t* data, size_t size);
+    void updateRts(size_t used);
 
   private:
+    enum {
+      STATE_LINE,
+      STATE_EXTENDED,
+      STATE_DATA_HEADER,
+      STATE_DATA_PAYLOAD
+    };
+
     HardwareSerial* _serial;
     int _rtcWakePin;
     int _wakeUpPin;
+    int _rtsPin;
+    int _ctsPin;
+    volatile bool _rtsHigh;
+    volatile bool _draining;
 
     Print* _debug;
 
+    int _state;
+    unsigned long _lastReceive;
+    int _nextTicket;
+    int _oldestTicket;
+    // this ticket and the older ones still in the queue were given up on
+    int _abandonedTicket;
+    unsigned long _abandonedAt;
+    int _responseCodes[WIFI_MODEM_MAX_PENDING];
+    unsigned long _sentAt[WIFI_MODEM_MAX_PENDING];
+    unsigned long _timeouts[WIFI_MODEM_MAX_PENDING];
+    char _line[48 + 1];
+    int _lineIndex;
+    String _response;
+    const char* _streamPrefix;
+    bool _responseStreamed;
+    bool _responseLong;
+
+#if WIFI_MODEM_RX_BUFFER_SIZE > 0
+    // single producer (drain) and single consumer (read), one slot is kept free
+    uint8_t _rxBuffer[WIFI_MODEM_RX_BUFFER_SIZE + 1];
+    volatile size_t _rxHead;
+    volatile size_t _rxTail;
+#endif
+    volatile size_t _rxHighWater;
+    volatile uint32_t _rxFull;
+
+    struct {
+      int cid;
+      IPAddress remoteIp;
+      uint16_t remotePort;
+      int length;
+      int offset;
+    } _frame;
+
     struct {
-      void(*handler)(void*, const char*, Stream&);
+      void(*handler)(void*, const char*);
       void* context;
     } _extendedResponse;
+
+    struct {
+      void(*handler)(void*, int, IPAddress, uint16_t, int, int, const uint8_t*, int);
+      void* context;
+    } _receive;
 };
 
 #endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#include "WiFiRingBuffer.h"
+
+WiFiRingBuffer::WiFiRingBuffer() :
+  _buffer(NULL),
+  _size(0),
+  _head(0),
+  _tail(0),
+  _count(0)
+{
+}
+
+WiFiRingBuffer::~WiFiRingBuffer()
+{
+}
+
+void WiFiRingBuffer::begin(uint8_t* buffer, size_t size)
+{
+  _buffer = buffer;
+  _size = size;
+
+  clear();
+}
+
+void WiFiRingBuffer::end()
+{
+  _buffer = NULL;
+  _size = 0;
+
+  clear();
+}
+
+uint8_t* WiFiRingBuffer::buffer()
+{
+  return _buffer;
+}
+
+size_t WiFiRingBuffer::size()
+{
+  return _size;
+}
+
+size_t WiFiRingBuffer::available()
+{
+  return _count;
+}
+
+size_t WiFiRingBuffer::availableForStore()
+{
+  return _size - _count;
+}
+
+size_t WiFiRingBuffer::write(const uint8_t* data, size_t size)
+{
+  if (size > availableForStore()) {
+    size = availableForStore();
+  }
+
+  if (size == 0) {
+    return 0;
+  }
+
+  // copy up to the end of the buffer, then wrap around
+  size_t first = _size - _head;
+
+  if (first > size) {
+    first = size;
+  }
+
+  memcpy(_buffer + _head, data, first);
+  memcpy(_buffer, data + first, size - first);
+
+  _head = (_head + size) % _size;
+  _count += size;
+
+  return size;
+}
+
+void WiFiRingBuffer::unwrite(size_t size)
+{
+  // remove the most recently written bytes
+  if (size > _count) {
+    size = _count;
+  }
+
+  _count -= size;
+
+  if (_count == 0) {
+    _head = 0;
+    _tail = 0;
+  } else {
+    _head = (_head + _size - size) % _size;
+  }
+}
+
+size_t WiFiRingBuffer::read(uint8_t* data, size_t size)
+{
+  if (size > _count) {
+    size = _count;
+  }
+
+  size_t first = _size - _tail;
+
+  if (first > size) {
+    first = size;
+  }
+
+  memcpy(data, _buffer + _tail, first);
+  memcpy(data + first, _buffer, size - first);
+
+  consume(size);
+
+  return size;
+}
+
+int WiFiRingBuffer::peek()
+{
+  if (_count == 0) {
+    return -1;
+  }
+
+  return _buffer[_tail];
+}
+
+const uint8_t* WiFiRingBuffer::peekBuffer()
+{
+  return _buffer + _tail;
+}
+
+size_t WiFiRingBuffer::peekAvailable()
+{
+  size_t first = _size - _tail;
+
+  if (first > _count) {
+    first = _count;
+  }
+
+  return first;
+}
+
+void WiFiRingBuffer::consume(size_t size)
+{
+  if (size > _count) {
+    size = _count;
+  }
+
+  _count -= size;
+
+  if (_count == 0) {
+    // restart at the beginning, so the next data is contiguous
+    _head = 0;
+    _tail = 0;
+  } else {
+    _tail = (_tail + size) % _size;
+  }
+}
+
+void WiFiRingBuffer::clear()
+{
+  _head = 0;
+  _tail = 0;
+  _count = 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2022 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: LGPL-2.1
+ * 
+ */
+
+#ifndef _WIFI_RING_BUFFER_H_
+#define _WIFI_RING_BUFFER_H_
+
+#include <Arduino.h>
+
+class WiFiRingBuffer {
+  public:
+    WiFiRingBuffer();
+    virtual ~WiFiRingBuffer();
+
+    void begin(uint8_t* buffer, size_t size);
+    void end();
+
+    uint8_t* buffer();
+    size_t size();
+    size_t available();
+    size_t availableForStore();
+
+    size_t write(const uint8_t* data, size_t size);
+    void unwrite(size_t size);
+    size_t read(uint8_t* data, size_t size);
+    int peek();
+
+    // contiguous readable region, valid until the next write, read or consume
+    const uint8_t* peekBuffer();
+    size_t peekAvailable();
+    void consume(size_t size);
+
+    void clear();
+
+  private:
+    uint8_t* _buffer;
+    size_t _size;
+    size_t _head;
+    size_t _tail;
+    size_t _count;
+};
+
+#endif
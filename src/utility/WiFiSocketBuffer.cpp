@@ -7,46 +7,105 @@
 
 #include "WiFiSocketBuffer.h"
 
-WiFiSocketBuffer::WiFiSocketBuffer()
+// UDP packets are queued in the receive buffer, each one preceded by this header
+struct WiFiSocketPacketHeader {
+  uint16_t length;
+  uint16_t remotePort;
+  uint32_t remoteIp;
+};
+
+// only referenced once a socket is opened, so sketches without sockets do not link it in
+static uint8_t* defaultPool()
 {
-  memset(&_sockets, 0x00, sizeof(_sockets));
+#if WIFI_SOCKET_BUFFER_POOL_SIZE > 0
+  static uint8_t pool[WIFI_SOCKET_BUFFER_POOL_SIZE];
+
+  return pool;
+#else
+  return NULL;
+#endif
+}
+
+WiFiSocketBuffer::WiFiSocketBuffer() :
+  _pool(NULL),
+  _poolSize(0),
+  _nextPeer(0)
+{
+  for (int i = 0; i < WIFI_SOCKET_MAX; i++) {
+    _sockets[i].droppedBytes = 0;
+    _sockets[i].droppedFrames = 0;
+  }
+
+  clear();
 }
 
 WiFiSocketBuffer::~WiFiSocketBuffer()
+{
+}
+
+void WiFiSocketBuffer::setPool(uint8_t* pool, size_t size)
 {
   for (int i = 0; i < 3; i++) {
-    if (i < 2) {
-      if (_sockets[i].rxBuffer.tcp != NULL) {
-        delete _sockets[i].rxBuffer.tcp;
-      }
-    } else {
-      if (_sockets[i].rxBuffer.udp != NULL) {
-        delete _sockets[i].rxBuffer.udp;
-      }
-    }
+    end(i);
   }
+
+  _pool = pool;
+  _poolSize = size;
 }
 
-void WiFiSocketBuffer::begin(int cid)
+int WiFiSocketBuffer::begin(int cid, size_t size)
 {
-  if (cid < 2) {
-    if (_sockets[cid].rxBuffer.tcp == NULL) {
-      _sockets[cid].rxBuffer.tcp = new RingBufferN<WIFI_SOCKET_TCP_BUFFER_SIZE>;
+  if (_sockets[cid].rxBuffer.buffer() == NULL || _sockets[cid].rxBuffer.size() != size) {
+    end(cid);
+
+    // may be less than size if the pool is short of room
+    uint8_t* buffer = allocate(cid, size);
+
+    if (buffer == NULL) {
+      return 0;
     }
-  } else {
-    if (_sockets[cid].rxBuffer.udp == NULL) {
-      _sockets[cid].rxBuffer.udp = new RingBufferN<WIFI_SOCKET_UDP_BUFFER_SIZE>;
+
+    _sockets[cid].rxBuffer.begin(buffer, size);
+  }
+
+  _sockets[cid].droppedBytes = 0;
+  _sockets[cid].droppedFrames = 0;
+
+  if (cid == 0) {
+    // the peers are given room in the server buffer as their data arrives, see placePeer()
+    for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+      clear(i);
+
+      _sockets[i].rxBuffer.end();
+      _sockets[i].droppedBytes = 0;
+      _sockets[i].droppedFrames = 0;
+    }
+  }
+
+  return 1;
+}
+
+void WiFiSocketBuffer::end(int cid)
+{
+  clear(cid);
+
+  if (cid == 0) {
+    for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+      _sockets[i].rxBuffer.end();
     }
   }
+
+  _sockets[cid].rxBuffer.end();
 }
 
 int WiFiSocketBuffer::available(int cid)
 {
-  if (cid < 2) {
-    return _sockets[cid].rxBuffer.tcp->available();
-  } else {
-    return _sockets[cid].rxBuffer.udp->available();
+  if (cid == 2) {
+    // only the remainder of the current packet
+    return _sockets[cid].packetRemaining;
   }
+
+  return _sockets[cid].rxBuffer.available();
 }
 
 int WiFiSocketBuffer::read(int cid, uint8_t* buf, size_t size)
@@ -57,14 +116,10 @@ int WiFiSocketBuffer::read(int cid, uint8_t* buf, size_t size)
     size = avail;
   }
 
-  if (cid < 2) {
-    for (size_t i = 0; i < size; i++) {
-      buf[i] = _sockets[cid].rxBuffer.tcp->read_char();
-    }
-  } else {
-    for (size_t i = 0; i < size; i++) {
-      buf[i] = _sockets[cid].rxBuffer.udp->read_char();
-    }
+  size = _sockets[cid].rxBuffer.read(buf, size);
+
+  if (cid == 2) {
+    _sockets[cid].packetRemaining -= size;
   }
 
   return size;
@@ -72,11 +127,87 @@ int WiFiSocketBuffer::read(int cid, uint8_t* buf, size_t size)
 
 int WiFiSocketBuffer::peek(int cid)
 {
-  if (cid < 2) {
-    return _sockets[cid].rxBuffer.tcp->peek();
-  } else {
-    return _sockets[cid].rxBuffer.udp->peek();
+  if (available(cid) == 0) {
+    return -1;
+  }
+
+  return _sockets[cid].rxBuffer.peek();
+}
+
+const uint8_t* WiFiSocketBuffer::peekBuffer(int cid)
+{
+  return _sockets[cid].rxBuffer.peekBuffer();
+}
+
+size_t WiFiSocketBuffer::peekAvailable(int cid)
+{
+  size_t avail = available(cid);
+  size_t size = _sockets[cid].rxBuffer.peekAvailable();
+
+  if (size > avail) {
+    size = avail;
+  }
+
+  return size;
+}
+
+void WiFiSocketBuffer::peekConsume(int cid, size_t size)
+{
+  if (size > peekAvailable(cid)) {
+    size = peekAvailable(cid);
+  }
+
+  _sockets[cid].rxBuffer.consume(size);
+
+  if (cid == 2) {
+    _sockets[cid].packetRemaining -= size;
+  }
+}
+
+int WiFiSocketBuffer::nextPacket(int cid)
+{
+  // skip what is left of the current packet
+  _sockets[cid].rxBuffer.consume(_sockets[cid].packetRemaining);
+  _sockets[cid].packetRemaining = 0;
+
+  if (_sockets[cid].packetsQueued == 0) {
+    return 0;
   }
+
+  WiFiSocketPacketHeader header;
+
+  _sockets[cid].rxBuffer.read((uint8_t*)&header, sizeof(header));
+  _sockets[cid].packetsQueued--;
+
+  _sockets[cid].remoteIp = header.remoteIp;
+  _sockets[cid].remotePort = header.remotePort;
+  _sockets[cid].packetRemaining = header.length;
+
+  return header.length;
+}
+
+void WiFiSocketBuffer::close(int cid)
+{
+  _sockets[cid].connected = false;
+  _sockets[cid].closed = true;
+}
+
+int WiFiSocketBuffer::nextClosed()
+{
+  for (int i = 0; i < WIFI_SOCKET_MAX; i++) {
+    if (_sockets[i].closed) {
+      _sockets[i].closed = false;
+
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+int WiFiSocketBuffer::packets(int cid)
+{
+  return _sockets[cid].packetsQueued;
 }
 
 void WiFiSocketBuffer::clear(int cid)
@@ -84,11 +215,24 @@ void WiFiSocketBuffer::clear(int cid)
   _sockets[cid].remoteIp = (uint32_t)0;
   _sockets[cid].remotePort = 0;
   _sockets[cid].connected = false;
+  _sockets[cid].accepted = false;
+  _sockets[cid].announced = false;
+  _sockets[cid].closed = false;
+  _sockets[cid].receiving = false;
+  _sockets[cid].overflow = false;
+  _sockets[cid].frameStored = 0;
+  _sockets[cid].packetsQueued = 0;
+  _sockets[cid].packetRemaining = 0;
+  _sockets[cid].rxBuffer.clear();
 
   if (cid < 2) {
-    _sockets[cid].rxBuffer.tcp->clear();
-  } else {
-    _sockets[cid].rxBuffer.udp->clear();
+    txClear(cid);
+  }
+
+  if (cid == 0) {
+    for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+      clear(i);
+    }
   }
 }
 
@@ -107,6 +251,16 @@ bool WiFiSocketBuffer::connected(int cid)
   return _sockets[cid].connected;
 }
 
+uint32_t WiFiSocketBuffer::droppedBytes(int cid)
+{
+  return _sockets[cid].droppedBytes;
+}
+
+uint32_t WiFiSocketBuffer::droppedFrames(int cid)
+{
+  return _sockets[cid].droppedFrames;
+}
+
 void WiFiSocketBuffer::clear()
 {
   for (int i = 0; i < 3; i++) {
@@ -119,48 +273,99 @@ void WiFiSocketBuffer::connect(int cid)
   _sockets[cid].connected = true;
 }
 
-void WiFiSocketBuffer::receive(int cid, IPAddress ip, uint16_t port, Stream& s, int length)
+void WiFiSocketBuffer::receive(int cid, IPAddress ip, uint16_t port, int length, int offset, const uint8_t* data, int size)
 {
-  int read = 0;
+  if (cid < 0 || cid > 2 || _sockets[cid].rxBuffer.size() == 0) {
+    return;
+  }
 
-  if (cid < 2) {
-    // TODO: timeout and handle overflows
-    while (read < length) {
-      if (s.available()) {
-        _sockets[cid].rxBuffer.tcp->store_char(s.read());
+  if (cid == 0) {
+    int socket = peerConnect(ip, port);
 
-        read++;
+    if (socket < 0) {
+      // no receive queue left for this peer
+      if (data != NULL) {
+        _sockets[cid].droppedBytes += size;
+      }
+      if (offset == 0) {
+        _sockets[cid].droppedFrames++;
+      }
+      return;
+    }
+
+    if (offset == 0 && _sockets[socket].rxBuffer.available() == 0) {
+      // nothing queued, so the queue can move to where there is room for this frame
+      placePeer(socket, length);
+    }
+
+    cid = socket;
+  }
+
+  if (cid != 2) {
+    if (offset == 0) {
+      _sockets[cid].overflow = false;
+    }
+
+    if (data == NULL) {
+      // frame abandoned by the modem, the missing bytes are lost
+      _sockets[cid].droppedBytes += size;
+      if (!_sockets[cid].overflow) {
+        _sockets[cid].droppedFrames++;
+      }
+      return;
+    }
+
+    // no flow control towards the modem, so bytes that do not fit are dropped
+    int stored = _sockets[cid].rxBuffer.write(data, size);
+
+    if (stored < size) {
+      _sockets[cid].droppedBytes += size - stored;
+      if (!_sockets[cid].overflow) {
+        _sockets[cid].overflow = true;
+        _sockets[cid].droppedFrames++;
       }
     }
 
     _sockets[cid].remoteIp = ip;
     _sockets[cid].remotePort = port;
   } else {
-    if (_sockets[cid].rxBuffer.udp->available() == 0) {
-      // TODO: timeout and handle overflow
-      while (read < length) {
-        if (s.available()) {
-          _sockets[cid].rxBuffer.udp->store_char(s.read());
-
-          read++;
-        }
+    if (offset == 0) {
+      WiFiSocketPacketHeader header;
+
+      header.length = length;
+      header.remotePort = port;
+      header.remoteIp = ip;
+
+      if ((sizeof(header) + length) <= _sockets[cid].rxBuffer.availableForStore()) {
+        _sockets[cid].rxBuffer.write((const uint8_t*)&header, sizeof(header));
+        _sockets[cid].receiving = true;
+        _sockets[cid].frameStored = sizeof(header);
+      } else {
+        // drop packet, not enough room left in the buffer
+        _sockets[cid].receiving = false;
+        _sockets[cid].droppedBytes += length;
+        _sockets[cid].droppedFrames++;
       }
+    }
 
-      _sockets[cid].remoteIp = ip;
-      _sockets[cid].remotePort = port;
-    } else {
-      // drop packet ...
+    if (!_sockets[cid].receiving) {
+      return;
     }
-  }
 
-  length -= read;
+    if (data == NULL) {
+      // frame abandoned by the modem, remove the partial packet
+      _sockets[cid].rxBuffer.unwrite(_sockets[cid].frameStored);
+      _sockets[cid].receiving = false;
+      _sockets[cid].droppedBytes += length;
+      _sockets[cid].droppedFrames++;
+      return;
+    }
 
-  // TODO: timeout
-  while (length) {
-    if (s.available()) {
-      s.read();
+    _sockets[cid].frameStored += _sockets[cid].rxBuffer.write(data, size);
 
-      length--;
+    if ((offset + size) >= length) {
+      _sockets[cid].receiving = false;
+      _sockets[cid].packetsQueued++;
     }
   }
 }
@@ -169,3 +374,320 @@ void WiFiSocketBuffer::disconnect(int cid)
 {
   _sockets[cid].connected = false;
 }
+
+int WiFiSocketBuffer::peerConnect(IPAddress ip, uint16_t port)
+{
+  if (_sockets[0].rxBuffer.size() == 0) {
+    return -1;
+  }
+
+  int socket = peer(ip, port);
+
+  if (socket > -1) {
+    return socket;
+  }
+
+  for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+    // a disconnected peer keeps its queue until the remaining data is read
+    if (!_sockets[i].connected && _sockets[i].rxBuffer.available() == 0) {
+      clear(i);
+
+      _sockets[i].remoteIp = ip;
+      _sockets[i].remotePort = port;
+      _sockets[i].connected = true;
+
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+void WiFiSocketBuffer::placePeer(int socket, size_t length)
+{
+  uint8_t* buffer = _sockets[0].rxBuffer.buffer();
+  size_t size = _sockets[0].rxBuffer.size();
+
+  // an even share of the server buffer between the connected peers, or more if the
+  // frame needs it, so a single peer has all of it
+  int connected = 0;
+
+  for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+    if (_sockets[i].connected || i == socket) {
+      connected++;
+    }
+  }
+
+  size_t share = size / connected;
+
+  if (share < WIFI_SOCKET_PEER_BUFFER_SIZE) {
+    share = WIFI_SOCKET_PEER_BUFFER_SIZE;
+  }
+
+  if (share < length) {
+    share = length;
+  }
+
+  // the largest gap between the queues still holding data
+  size_t gapStart = 0;
+  size_t gapSize = 0;
+
+  for (size_t start = 0; start < size;) {
+    size_t end = size;
+    size_t next = size;
+
+    for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+      if (i == socket || _sockets[i].rxBuffer.available() == 0) {
+        continue;
+      }
+
+      size_t usedStart = _sockets[i].rxBuffer.buffer() - buffer;
+      size_t usedEnd = usedStart + _sockets[i].rxBuffer.size();
+
+      if (usedStart <= start && start < usedEnd) {
+        // inside a queue, continue after it
+        next = usedEnd;
+        end = start;
+        break;
+      }
+
+      if (usedStart > start && usedStart < end) {
+        end = usedStart;
+        next = usedEnd;
+      }
+    }
+
+    if ((end - start) > gapSize) {
+      gapStart = start;
+      gapSize = end - start;
+    }
+
+    start = next;
+  }
+
+  for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+    if (i != socket && _sockets[i].rxBuffer.available() == 0) {
+      // empty queues hold no room, they are placed again when their next frame arrives
+      _sockets[i].rxBuffer.end();
+    }
+  }
+
+  if (gapSize == 0) {
+    // the other peers hold all of it, what this one sends is dropped until they are read
+    _sockets[socket].rxBuffer.end();
+    return;
+  }
+
+  _sockets[socket].rxBuffer.begin(buffer + gapStart, (gapSize < share) ? gapSize : share);
+}
+
+void WiFiSocketBuffer::peerDisconnect(IPAddress ip, uint16_t port)
+{
+  int socket = peer(ip, port);
+
+  if (socket > -1) {
+    close(socket);
+  }
+}
+
+int WiFiSocketBuffer::peer(IPAddress ip, uint16_t port)
+{
+  for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+    if (_sockets[i].remoteIp == ip && _sockets[i].remotePort == port &&
+        (_sockets[i].connected || _sockets[i].rxBuffer.available() != 0)) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+int WiFiSocketBuffer::availablePeer()
+{
+  // round robin, so a busy peer does not starve the others
+  for (int i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++) {
+    int socket = WIFI_SOCKET_FIRST_PEER + ((_nextPeer + i) % WIFI_SERVER_MAX_CLIENTS);
+
+    if (_sockets[socket].rxBuffer.available() != 0) {
+      _nextPeer = (socket - WIFI_SOCKET_FIRST_PEER + 1) % WIFI_SERVER_MAX_CLIENTS;
+
+      return socket;
+    }
+  }
+
+  return -1;
+}
+
+bool WiFiSocketBuffer::peerReady()
+{
+  // a peer has data, or has newly connected, which is reported once so sketches that
+  // serve peers with available() instead of accept() do not see it as ready forever
+  bool ready = false;
+
+  for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+    if (_sockets[i].rxBuffer.available() != 0) {
+      ready = true;
+    } else if (_sockets[i].connected && !_sockets[i].accepted && !_sockets[i].announced) {
+      _sockets[i].announced = true;
+      ready = true;
+    }
+  }
+
+  return ready;
+}
+
+int WiFiSocketBuffer::acceptPeer()
+{
+  for (int i = WIFI_SOCKET_FIRST_PEER; i < WIFI_SOCKET_MAX; i++) {
+    if (_sockets[i].connected && !_sockets[i].accepted) {
+      _sockets[i].accepted = true;
+
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+size_t WiFiSocketBuffer::txStore(int cid, IPAddress ip, uint16_t port, const uint8_t* data, size_t size, unsigned long delay)
+{
+  if (cid < 0 || cid > 1) {
+    return 0;
+  }
+
+  if (_tx[cid].length == 0) {
+    _tx[cid].remoteIp = ip;
+    _tx[cid].remotePort = port;
+    _tx[cid].start = millis();
+    _tx[cid].delay = delay;
+  } else if (_tx[cid].remoteIp != ip || _tx[cid].remotePort != port) {
+    // only data for a single peer can be sent in one frame
+    return 0;
+  }
+
+  if (size > txAvailableForStore(cid)) {
+    size = txAvailableForStore(cid);
+  }
+
+  memcpy(_tx[cid].buffer + _tx[cid].length, data, size);
+  _tx[cid].length += size;
+
+  return size;
+}
+
+size_t WiFiSocketBuffer::txAvailable(int cid)
+{
+  return _tx[cid].length;
+}
+
+size_t WiFiSocketBuffer::txAvailableForStore(int cid)
+{
+  return sizeof(_tx[cid].buffer) - _tx[cid].length;
+}
+
+const uint8_t* WiFiSocketBuffer::txBuffer(int cid)
+{
+  return _tx[cid].buffer;
+}
+
+IPAddress WiFiSocketBuffer::txRemoteIP(int cid)
+{
+  return _tx[cid].remoteIp;
+}
+
+uint16_t WiFiSocketBuffer::txRemotePort(int cid)
+{
+  return _tx[cid].remotePort;
+}
+
+bool WiFiSocketBuffer::txDue(int cid)
+{
+  return (_tx[cid].length > 0) && ((millis() - _tx[cid].start) >= _tx[cid].delay);
+}
+
+void WiFiSocketBuffer::txConsume(int cid, size_t size)
+{
+  if (size >= _tx[cid].length) {
+    txClear(cid);
+    return;
+  }
+
+  // drop the sent bytes, the rest stays for the same peer
+  memmove(_tx[cid].buffer, _tx[cid].buffer + size, _tx[cid].length - size);
+  _tx[cid].length -= size;
+}
+
+void WiFiSocketBuffer::txClear(int cid)
+{
+  _tx[cid].length = 0;
+  _tx[cid].remoteIp = (uint32_t)0;
+  _tx[cid].remotePort = 0;
+}
+
+uint8_t* WiFiSocketBuffer::allocate(int cid, size_t& size)
+{
+  if (_pool == NULL && _poolSize == 0) {
+    _pool = defaultPool();
+    _poolSize = WIFI_SOCKET_BUFFER_POOL_SIZE;
+  }
+
+  if (_pool == NULL || size == 0) {
+    return NULL;
+  }
+
+  size_t largestStart = 0;
+  size_t largestSize = 0;
+
+  // first fit, candidates are the start of the pool and the end of each buffer in use
+  for (int i = -1; i < 3; i++) {
+    size_t start = 0;
+
+    if (i > -1) {
+      if (i == cid || _sockets[i].rxBuffer.buffer() == NULL) {
+        continue;
+      }
+
+      start = (_sockets[i].rxBuffer.buffer() - _pool) + _sockets[i].rxBuffer.size();
+    }
+
+    // room up to the next buffer in use
+    size_t end = _poolSize;
+
+    for (int j = 0; j < 3; j++) {
+      if (j == cid || _sockets[j].rxBuffer.buffer() == NULL) {
+        continue;
+      }
+
+      size_t usedStart = _sockets[j].rxBuffer.buffer() - _pool;
+      size_t usedEnd = usedStart + _sockets[j].rxBuffer.size();
+
+      if (usedStart <= start && start < usedEnd) {
+        end = start;
+        break;
+      }
+
+      if (usedStart > start && usedStart < end) {
+        end = usedStart;
+      }
+    }
+
+    if ((end - start) >= size) {
+      return _pool + start;
+    }
+
+    if ((end - start) > largestSize) {
+      largestStart = start;
+      largestSize = end - start;
+    }
+  }
+
+  // the pool is short of room, for example with a client and a server open at once,
+  // make do with a smaller buffer rather than failing
+  if (largestSize >= WIFI_SOCKET_MIN_BUFFER_SIZE) {
+    size = largestSize;
+
+    return _pool + largestStart;
+  }
+
+  return NULL;
+}
@@ -11,44 +11,137 @@
 #include <Arduino.h>
 #include <IPAddress.h>
 
+#include "WiFiRingBuffer.h"
+
+// default receive buffer sizes, can be changed per socket with setBufferSize()
 #define WIFI_SOCKET_TCP_BUFFER_SIZE 4096
 #define WIFI_SOCKET_UDP_BUFFER_SIZE 1500
 
+// receive buffers are taken from a statically allocated pool, by default room for one TCP
+// socket (client or server) and one UDP socket, define as 0 to leave it out and provide the
+// memory with WiFi.setBufferPool(...) instead, or larger to open a client and a server at once
+// with their full buffer sizes, it is only linked in when a sketch opens a socket
+#ifndef WIFI_SOCKET_BUFFER_POOL_SIZE
+#define WIFI_SOCKET_BUFFER_POOL_SIZE (WIFI_SOCKET_TCP_BUFFER_SIZE + WIFI_SOCKET_UDP_BUFFER_SIZE)
+#endif
+
+// when the pool has no room for the requested size, a socket gets the largest free part of it
+// instead, if that is at least this size
+#ifndef WIFI_SOCKET_MIN_BUFFER_SIZE
+#define WIFI_SOCKET_MIN_BUFFER_SIZE 512
+#endif
+
+// TCP server peers get a receive queue of their own, carved out of the server receive
+// buffer, an even share between the connected peers (all of it for a single peer) but at
+// least this size or the length of the frame being received
+#ifndef WIFI_SOCKET_PEER_BUFFER_SIZE
+#define WIFI_SOCKET_PEER_BUFFER_SIZE 1024
+#endif
+
+#ifndef WIFI_SERVER_MAX_CLIENTS
+#define WIFI_SERVER_MAX_CLIENTS 8
+#endif
+
+// sockets 0 to 2 match the modem cids, the TCP server peers follow
+#define WIFI_SOCKET_FIRST_PEER 3
+#define WIFI_SOCKET_MAX (WIFI_SOCKET_FIRST_PEER + WIFI_SERVER_MAX_CLIENTS)
+
+// small TCP writes are held back in a buffer of this size when no delay is disabled,
+// see WiFiClient::setNoDelay()
+#ifndef WIFI_SOCKET_TX_BUFFER_SIZE
+#define WIFI_SOCKET_TX_BUFFER_SIZE 256
+#endif
+
 class WiFiSocketBuffer {
   public:
     WiFiSocketBuffer();
     virtual ~WiFiSocketBuffer();
 
-    void begin(int cid);
+    void setPool(uint8_t* pool, size_t size);
+
+    int begin(int cid, size_t size);
+    void end(int cid);
 
     int available(int cid);
     int read(int cid, uint8_t* buf, size_t size);
     int peek(int cid);
+    const uint8_t* peekBuffer(int cid);
+    size_t peekAvailable(int cid);
+    void peekConsume(int cid, size_t size);
+    int nextPacket(int cid);
+    int packets(int cid);
 
+    // the remote side closed the connection, reported once by nextClosed()
     void close(int cid);
+    int nextClosed();
 
     void clear(int cid);
 
     IPAddress remoteIP(int cid);
     uint16_t remotePort(int cid);
     bool connected(int cid);
+    uint32_t droppedBytes(int cid);
+    uint32_t droppedFrames(int cid);
 
     void clear();
 
     void connect(int cid);
-    void receive(int cid, IPAddress ip, uint16_t port, Stream& s, int length);
+    void receive(int cid, IPAddress ip, uint16_t port, int length, int offset, const uint8_t* data, int size);
     void disconnect(int cid);
 
+    // TCP server peers, data received on cid 0 is sorted into the socket of the sending peer
+    int peerConnect(IPAddress ip, uint16_t port);
+    void peerDisconnect(IPAddress ip, uint16_t port);
+    int peer(IPAddress ip, uint16_t port);
+    int availablePeer();
+    int acceptPeer();
+    bool peerReady();
+
+    // transmit side, written data waiting to be sent as one frame to a single peer
+    size_t txStore(int cid, IPAddress ip, uint16_t port, const uint8_t* data, size_t size, unsigned long delay);
+    size_t txAvailable(int cid);
+    size_t txAvailableForStore(int cid);
+    const uint8_t* txBuffer(int cid);
+    IPAddress txRemoteIP(int cid);
+    uint16_t txRemotePort(int cid);
+    bool txDue(int cid);
+    void txConsume(int cid, size_t size);
+    void txClear(int cid);
+
+private:
+    uint8_t* allocate(int cid, size_t& size);
+    void placePeer(int socket, size_t length);
+
 private:
+    uint8_t* _pool;
+    size_t _poolSize;
+
     struct {
-      union WiFiSocketBuffer {
-        RingBufferN<WIFI_SOCKET_TCP_BUFFER_SIZE>* tcp;
-        RingBufferN<WIFI_SOCKET_UDP_BUFFER_SIZE>* udp;
-      } rxBuffer;
+      WiFiRingBuffer rxBuffer;
       IPAddress remoteIp;
       uint16_t remotePort;
       bool connected;
-    } _sockets[3];
+      bool accepted;
+      bool announced;
+      bool closed;
+      bool receiving;
+      bool overflow;
+      size_t frameStored;
+      int packetsQueued;
+      size_t packetRemaining;
+      uint32_t droppedBytes;
+      uint32_t droppedFrames;
+    } _sockets[WIFI_SOCKET_MAX];
+    int _nextPeer;
+
+    struct {
+      uint8_t buffer[WIFI_SOCKET_TX_BUFFER_SIZE];
+      size_t length;
+      IPAddress remoteIp;
+      uint16_t remotePort;
+      unsigned long start;
+      unsigned long delay;
+    } _tx[2];
 };
 
 #endif